@@ -0,0 +1,112 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <algorithm>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+using namespace std;
+
+// Frame times and draw counts of a --benchmark run, written out as one JSON object (or an array of them for a sweep).
+class BenchmarkResults
+{
+public:
+    string scene;
+    string renderer;
+    unsigned int width = 0, height = 0;
+    // fixed time step the scene advanced by every frame
+    float deltaTime = 0.0f;
+    // what a sweep varies between runs, written as extra numeric fields
+    vector<pair<string, double>> parameters;
+
+    void addFrame(float milliseconds, unsigned int drawCalls, unsigned int draws)
+    {
+        frameMilliseconds.push_back(milliseconds);
+        this->drawCalls.push_back(drawCalls);
+        this->draws.push_back(draws);
+    }
+
+    void writeJson(ostream &out) const
+    {
+        writeObject(out);
+        out << endl;
+    }
+
+    static void writeJson(ostream &out, const vector<BenchmarkResults> &runs)
+    {
+        out << "[\n";
+        for (size_t i = 0; i < runs.size(); i++) {
+            runs[i].writeObject(out);
+            out << (i + 1 < runs.size() ? ",\n" : "\n");
+        }
+        out << "]" << endl;
+    }
+
+private:
+    vector<float> frameMilliseconds;
+    vector<unsigned int> drawCalls;
+    vector<unsigned int> draws;
+
+    void writeObject(ostream &out) const
+    {
+        vector<float> sorted(frameMilliseconds);
+        sort(sorted.begin(), sorted.end());
+        double sum = 0.0;
+        for (float milliseconds : sorted)
+            sum += milliseconds;
+
+        out << "{\n"
+            << "  \"scene\": \"" << escape(scene) << "\",\n"
+            << "  \"renderer\": \"" << escape(renderer) << "\",\n"
+            << "  \"width\": " << width << ",\n"
+            << "  \"height\": " << height << ",\n"
+            << "  \"frames\": " << sorted.size() << ",\n"
+            << "  \"delta_time\": " << deltaTime << ",\n";
+        for (const pair<string, double> &parameter : parameters)
+            out << "  \"" << escape(parameter.first) << "\": " << parameter.second << ",\n";
+        out << "  \"frame_ms\": {"
+            << "\"avg\": " << (sorted.empty() ? 0.0 : sum / sorted.size())
+            << ", \"min\": " << percentile(sorted, 0.0f)
+            << ", \"p50\": " << percentile(sorted, 0.5f)
+            << ", \"p95\": " << percentile(sorted, 0.95f)
+            << ", \"p99\": " << percentile(sorted, 0.99f)
+            << ", \"max\": " << percentile(sorted, 1.0f) << "},\n"
+            << "  \"draw_calls\": " << counts(drawCalls) << ",\n"
+            << "  \"draws\": " << counts(draws) << "\n"
+            << "}";
+    }
+
+    // nearest rank
+    static float percentile(const vector<float> &sorted, float p)
+    {
+        if (sorted.empty())
+            return 0.0f;
+        size_t rank = (size_t) (p * (sorted.size() - 1) + 0.5f);
+        return sorted[min(rank, sorted.size() - 1)];
+    }
+
+    static string counts(const vector<unsigned int> &values)
+    {
+        double sum = 0.0;
+        unsigned int largest = 0;
+        for (unsigned int value : values) {
+            sum += value;
+            largest = max(largest, value);
+        }
+        return "{\"avg\": " + to_string(values.empty() ? 0.0 : sum / values.size()) + ", \"max\": " + to_string(largest) + "}";
+    }
+
+    static string escape(const string &text)
+    {
+        string escaped;
+        for (char c : text) {
+            if (c == '"' || c == '\\')
+                escaped += '\\';
+            if ((unsigned char) c >= 0x20)
+                escaped += c;
+        }
+        return escaped;
+    }
+};
+#endif
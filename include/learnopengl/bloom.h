@@ -0,0 +1,201 @@
+#ifndef BLOOM_H
+#define BLOOM_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/shader.h>
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+using namespace std;
+
+enum BloomMode {
+    // amount alternating horizontal and vertical 9-tap Gaussian passes at full resolution
+    BLOOM_PINGPONG,
+    // progressive downsample and upsample through a chain of ever smaller textures
+    BLOOM_MIP_CHAIN
+};
+
+// Blurs the bright color buffer for the bloom composite, two ways:
+// - ping-pong: the original blur.fs passes, each reading and writing the whole screen, so a wider glow costs
+//   proportionally more full-resolution passes.
+// - mip chain: bloom_downsample.fs halves the image MIP_LEVELS times with a 13-tap filter (Jimenez, "Next
+//   generation post processing in Call of Duty: Advanced Warfare"), then bloom_upsample.fs walks back up with a
+//   3x3 tent filter, adding each level onto the next larger one. The glow reaches as far as the smallest level's
+//   texels, but every level has a quarter of the pixels of the one above, so the whole chain costs about a third of
+//   one full-resolution pass. Levels are R11F_G11F_B10F, half the bytes of the RGBA16F ping-pong buffers.
+// Both draw full-screen triangles from gl_VertexID (bloom_pass.vs), so they need no vertex buffers.
+class BloomRenderer
+{
+public:
+    static const unsigned int MIP_LEVELS = 6;
+
+    BloomMode mode = BLOOM_MIP_CHAIN;
+    // passes of the ping-pong blur
+    unsigned int amount = 10;
+    // upsampling tent radius, in texels of the smaller level
+    float filterRadius = 1.0f;
+
+    // creates the buffers of both paths, needs a current context
+    void init(unsigned int width, unsigned int height, Shader &blurShader, Shader &downsampleShader, Shader &upsampleShader)
+    {
+        this->width = width;
+        this->height = height;
+
+        glGenFramebuffers(2, pingpongFBO);
+        glGenTextures(2, pingpongColorbuffers);
+        for (unsigned int i = 0; i < 2; i++) {
+            glBindFramebuffer(GL_FRAMEBUFFER, pingpongFBO[i]);
+            createTexture(pingpongColorbuffers[i], GL_RGBA16F, width, height);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pingpongColorbuffers[i], 0);
+            if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+                cout << "ERROR::BLOOM:: ping-pong framebuffer not complete" << endl;
+        }
+
+        // level 0 is half the screen, every next one half of that
+        glGenFramebuffers(1, &mipFBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, mipFBO);
+        mips.clear();
+        unsigned int mipWidth = width, mipHeight = height;
+        for (unsigned int level = 0; level < MIP_LEVELS && mipWidth > 1 && mipHeight > 1; level++) {
+            Mip mip;
+            mip.width = mipWidth = max(mipWidth / 2, 1u);
+            mip.height = mipHeight = max(mipHeight / 2, 1u);
+            glGenTextures(1, &mip.texture);
+            createTexture(mip.texture, GL_R11F_G11F_B10F, mip.width, mip.height);
+            mips.push_back(mip);
+        }
+        if (!mips.empty()) {
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, mips[0].texture, 0);
+            if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+                cout << "ERROR::BLOOM:: mip chain framebuffer not complete" << endl;
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        glGenVertexArrays(1, &emptyVAO);
+
+        blurShader.use();
+        blurShader.setInt("image", 0);
+        horizontalUniform = blurShader.uniform<bool>("horizontal");
+        downsampleShader.use();
+        downsampleShader.setInt("source", 0);
+        downsampleTexelUniform = downsampleShader.uniform<glm::vec2>("sourceTexelSize");
+        upsampleShader.use();
+        upsampleShader.setInt("source", 0);
+        upsampleRadiusUniform = upsampleShader.uniform<glm::vec2>("filterRadius");
+    }
+
+    // blurs brightTexture (screen sized) with the current mode and returns the texture holding the result.
+    // leaves framebuffer 0 bound with the full screen viewport, and texture unit 0 active
+    GLuint render(GLuint brightTexture, Shader &blurShader, Shader &downsampleShader, Shader &upsampleShader)
+    {
+        glDisable(GL_DEPTH_TEST);
+        glBindVertexArray(emptyVAO);
+        glActiveTexture(GL_TEXTURE0);
+        GLuint result = mode == BLOOM_MIP_CHAIN && !mips.empty()
+                      ? renderMipChain(brightTexture, downsampleShader, upsampleShader)
+                      : renderPingPong(brightTexture, blurShader);
+        glBindVertexArray(0);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(0, 0, width, height);
+        glEnable(GL_DEPTH_TEST);
+        return result;
+    }
+
+    // the mip chain adds up every level, the composite scales it back to about the ping-pong blur's brightness
+    float strength() const
+    {
+        return mode == BLOOM_MIP_CHAIN && !mips.empty() ? 1.0f / mips.size() : 1.0f;
+    }
+
+    void destroy()
+    {
+        glDeleteFramebuffers(2, pingpongFBO);
+        glDeleteTextures(2, pingpongColorbuffers);
+        glDeleteFramebuffers(1, &mipFBO);
+        for (Mip &mip : mips)
+            glDeleteTextures(1, &mip.texture);
+        mips.clear();
+        glDeleteVertexArrays(1, &emptyVAO);
+    }
+
+private:
+    struct Mip {
+        unsigned int width, height;
+        GLuint texture;
+    };
+
+    unsigned int width = 0, height = 0;
+    GLuint pingpongFBO[2] = {0, 0};
+    GLuint pingpongColorbuffers[2] = {0, 0};
+    GLuint mipFBO = 0;
+    vector<Mip> mips;
+    GLuint emptyVAO = 0;
+    Uniform<bool> horizontalUniform;
+    Uniform<glm::vec2> downsampleTexelUniform;
+    Uniform<glm::vec2> upsampleRadiusUniform;
+
+    static void createTexture(GLuint texture, GLenum format, unsigned int width, unsigned int height)
+    {
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, GL_RGBA, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        // clamped, the filters would otherwise sample repeated texture values
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+
+    GLuint renderPingPong(GLuint brightTexture, Shader &blurShader)
+    {
+        bool horizontal = true, first_iteration = true;
+        glViewport(0, 0, width, height);
+        blurShader.use();
+        for (unsigned int i = 0; i < amount; i++) {
+            glBindFramebuffer(GL_FRAMEBUFFER, pingpongFBO[horizontal]);
+            blurShader.set(horizontalUniform, horizontal);
+            glBindTexture(GL_TEXTURE_2D, first_iteration ? brightTexture : pingpongColorbuffers[!horizontal]);  // bind texture of other framebuffer (or scene if first iteration)
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+            horizontal = !horizontal;
+            if (first_iteration)
+                first_iteration = false;
+        }
+        return amount == 0 ? brightTexture : pingpongColorbuffers[!horizontal];
+    }
+
+    GLuint renderMipChain(GLuint brightTexture, Shader &downsampleShader, Shader &upsampleShader)
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, mipFBO);
+
+        downsampleShader.use();
+        downsampleShader.set(downsampleTexelUniform, glm::vec2(1.0f / width, 1.0f / height));
+        glBindTexture(GL_TEXTURE_2D, brightTexture);
+        for (const Mip &mip : mips) {
+            glViewport(0, 0, mip.width, mip.height);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, mip.texture, 0);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+            // the next level reads this one
+            downsampleShader.set(downsampleTexelUniform, glm::vec2(1.0f / mip.width, 1.0f / mip.height));
+            glBindTexture(GL_TEXTURE_2D, mip.texture);
+        }
+
+        // each level adds the blurred smaller one onto its own downsample
+        upsampleShader.use();
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_ONE, GL_ONE);
+        for (size_t level = mips.size() - 1; level > 0; level--) {
+            const Mip &source = mips[level], &target = mips[level - 1];
+            upsampleShader.set(upsampleRadiusUniform, glm::vec2(filterRadius / source.width, filterRadius / source.height));
+            glBindTexture(GL_TEXTURE_2D, source.texture);
+            glViewport(0, 0, target.width, target.height);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target.texture, 0);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+        }
+        glDisable(GL_BLEND);
+        return mips[0].texture;
+    }
+};
+#endif
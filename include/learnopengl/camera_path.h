@@ -0,0 +1,74 @@
+#ifndef CAMERA_PATH_H
+#define CAMERA_PATH_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/camera.h>
+
+#include <cmath>
+#include <vector>
+using namespace std;
+
+// A closed Catmull-Rom spline of camera positions and the points the camera looks at, for replaying the same
+// flight every run (the --benchmark mode).
+class CameraPath
+{
+public:
+    struct Key {
+        glm::vec3 position;
+        glm::vec3 target;
+    };
+    vector<Key> keys;
+
+    // a loop around center, swinging in and out between radius and half of it and up and down with it,
+    // looking at points around center so the view doesn't stay on one spot
+    static CameraPath orbit(glm::vec3 center, float radius, unsigned int keyCount = 8)
+    {
+        CameraPath path;
+        for (unsigned int i = 0; i < keyCount; i++) {
+            float angle = glm::radians(360.0f) * i / keyCount;
+            float distance = i % 2 == 0 ? radius : radius * 0.5f;
+            Key key;
+            key.position = center + glm::vec3(cos(angle) * distance, (i % 2 == 0 ? 0.4f : 0.1f) * radius, sin(angle) * distance);
+            key.target = center + glm::vec3(cos(angle + 1.0f), 0.0f, sin(angle + 1.0f)) * radius * 0.2f;
+            path.keys.push_back(key);
+        }
+        return path;
+    }
+
+    // t in [0, 1) goes around the loop once
+    Key sample(float t) const
+    {
+        float position = (t - floor(t)) * keys.size();
+        int segment = (int) position;
+        float s = position - segment;
+        const Key &k0 = key(segment - 1), &k1 = key(segment), &k2 = key(segment + 1), &k3 = key(segment + 2);
+        Key result;
+        result.position = catmullRom(k0.position, k1.position, k2.position, k3.position, s);
+        result.target = catmullRom(k0.target, k1.target, k2.target, k3.target, s);
+        return result;
+    }
+
+    // puts the camera at t along the path
+    void apply(Camera &camera, float t) const
+    {
+        Key key = sample(t);
+        camera.Position = key.position;
+        camera.LookAt(key.target);
+    }
+
+private:
+    const Key &key(int i) const
+    {
+        int count = keys.size();
+        return keys[((i % count) + count) % count];
+    }
+
+    static glm::vec3 catmullRom(glm::vec3 p0, glm::vec3 p1, glm::vec3 p2, glm::vec3 p3, float s)
+    {
+        float s2 = s * s, s3 = s2 * s;
+        return 0.5f * (2.0f * p1 + (p2 - p0) * s + (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * s2
+                       + (3.0f * p1 - p0 - 3.0f * p2 + p3) * s3);
+    }
+};
+#endif
@@ -0,0 +1,239 @@
+#ifndef CULLING_H
+#define CULLING_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/model.h>
+#include <learnopengl/scene.h>
+
+#include <cstdint>
+#include <vector>
+using namespace std;
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define CULLING_SSE 1
+#endif
+
+// the six planes of a view frustum, (normal, distance) with normals pointing inwards
+struct Frustum {
+    glm::vec4 planes[6];
+
+    // extracts the planes from a projection * view matrix (Gribb/Hartmann)
+    static Frustum fromMatrix(const glm::mat4 &m)
+    {
+        // glm is column major, m[column][row]
+        glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+        glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+        glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+        glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+        Frustum frustum;
+        frustum.planes[0] = row3 + row0; // left
+        frustum.planes[1] = row3 - row0; // right
+        frustum.planes[2] = row3 + row1; // bottom
+        frustum.planes[3] = row3 - row1; // top
+        frustum.planes[4] = row3 + row2; // near
+        frustum.planes[5] = row3 - row2; // far
+        for (glm::vec4 &plane : frustum.planes)
+            plane = plane / glm::length(glm::vec3(plane));
+        return frustum;
+    }
+
+    bool intersectsSphere(const glm::vec3 &center, float radius) const
+    {
+        for (const glm::vec4 &plane : planes)
+            if (glm::dot(glm::vec3(plane), center) + plane.w < -radius)
+                return false;
+        return true;
+    }
+};
+
+// Tests count world space spheres, given as separate x, y, z and radius arrays, against the frustum and writes
+// 1 (visible) or 0 (culled) for each of them to visible. Four spheres at a time with SSE when it's available.
+inline void cullSpheres(const Frustum &frustum, const float *x, const float *y, const float *z, const float *radius,
+                        size_t count, uint8_t *visible)
+{
+    size_t i = 0;
+#ifdef CULLING_SSE
+    __m128 planeX[6], planeY[6], planeZ[6], planeW[6];
+    for (int p = 0; p < 6; p++) {
+        planeX[p] = _mm_set1_ps(frustum.planes[p].x);
+        planeY[p] = _mm_set1_ps(frustum.planes[p].y);
+        planeZ[p] = _mm_set1_ps(frustum.planes[p].z);
+        planeW[p] = _mm_set1_ps(frustum.planes[p].w);
+    }
+    for (; i + 4 <= count; i += 4) {
+        __m128 cx = _mm_loadu_ps(x + i);
+        __m128 cy = _mm_loadu_ps(y + i);
+        __m128 cz = _mm_loadu_ps(z + i);
+        __m128 r = _mm_loadu_ps(radius + i);
+        __m128 inside = _mm_cmpeq_ps(_mm_setzero_ps(), _mm_setzero_ps()); // all bits set
+        for (int p = 0; p < 6; p++) {
+            // signed distance + radius >= 0 for every plane
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(planeX[p], cx), _mm_mul_ps(planeY[p], cy)),
+                                         _mm_add_ps(_mm_mul_ps(planeZ[p], cz), planeW[p]));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(distance, r), _mm_setzero_ps()));
+        }
+        int mask = _mm_movemask_ps(inside);
+        visible[i] = mask & 1;
+        visible[i + 1] = (mask >> 1) & 1;
+        visible[i + 2] = (mask >> 2) & 1;
+        visible[i + 3] = (mask >> 3) & 1;
+    }
+#endif
+    for (; i < count; i++)
+        visible[i] = frustum.intersectsSphere(glm::vec3(x[i], y[i], z[i]), radius[i]);
+}
+
+// what level of detail selection needs of the camera
+struct LodView {
+    glm::vec3 position;
+    // pixels per world unit at distance 1: viewport height / (2 tan(fov / 2))
+    float pixelsPerUnit;
+
+    static LodView fromCamera(const glm::vec3 &position, float fovDegrees, float viewportHeight)
+    {
+        return {position, viewportHeight / (2.0f * tan(glm::radians(fovDegrees) * 0.5f))};
+    }
+};
+
+// Culls every mesh of every scene entity against the view frustum, using the meshes' bounding spheres, and picks a
+// level of detail for every visible instance. The world matrices of the visible instances are packed into transforms,
+// one Range per batch, mesh and level of detail, so each range can be drawn with one instanced draw.
+class SceneCuller
+{
+public:
+    struct Range {
+        unsigned int batch;
+        unsigned int mesh;
+        unsigned int lod;
+        unsigned int first;
+        unsigned int count;
+    };
+
+    bool enabled = true;
+    // mesh instances of the last cull()
+    unsigned int visibleCount = 0;
+    unsigned int culledCount = 0;
+
+    bool lodEnabled = true;
+    // coarsest level whose simplification error projects to at most this many pixels
+    float lodPixelError = 1.0f;
+    // switching to a coarser level needs the error this much below the threshold, so instances near it don't pop
+    float lodHysteresis = 0.3f;
+    // visible instances drawn at every level of detail, in the last cull()
+    vector<unsigned int> lodCounts;
+
+    vector<glm::mat4> transforms;
+    vector<Range> ranges;
+
+    void cull(const Frustum &frustum, const LodView &view, const Scene &scene, const vector<Model> &models)
+    {
+        // world matrix and world space sphere of every mesh instance, ordered by batch, mesh and entity.
+        // the mesh's node transform goes in between entity and mesh, so every node is culled on its own
+        worlds.clear();
+        scales.clear();
+        sphereX.clear();
+        sphereY.clear();
+        sphereZ.clear();
+        sphereRadius.clear();
+        for (const SceneBatch &batch : scene.batches) {
+            const Model &model = models[batch.model];
+            for (unsigned int m = 0; m < model.meshes.size(); m++) {
+                const Mesh &mesh = model.meshes[m];
+                const glm::mat4 &node = model.meshTransform(m);
+                bool identityNode = node == glm::mat4(1.0f);
+                for (unsigned int i = batch.first; i < batch.first + batch.count; i++) {
+                    worlds.push_back(identityNode ? scene.transforms[i] : scene.transforms[i] * node);
+                    const glm::mat4 &world = worlds.back();
+                    // largest axis scale, scales the sphere radius
+                    float scale = sqrt(glm::max(glm::dot(glm::vec3(world[0]), glm::vec3(world[0])),
+                                                glm::max(glm::dot(glm::vec3(world[1]), glm::vec3(world[1])),
+                                                         glm::dot(glm::vec3(world[2]), glm::vec3(world[2])))));
+                    glm::vec4 center = world * glm::vec4(mesh.bounds.center, 1.0f);
+                    scales.push_back(scale);
+                    sphereX.push_back(center.x);
+                    sphereY.push_back(center.y);
+                    sphereZ.push_back(center.z);
+                    sphereRadius.push_back(mesh.bounds.radius * scale);
+                }
+            }
+        }
+
+        visible.resize(sphereX.size());
+        if (enabled)
+            cullSpheres(frustum, sphereX.data(), sphereY.data(), sphereZ.data(), sphereRadius.data(), sphereX.size(), visible.data());
+        else
+            fill(visible.begin(), visible.end(), 1);
+
+        // level of every sphere, kept across frames for the hysteresis; starts over when the scene changes
+        if (lods.size() != sphereX.size())
+            lods.assign(sphereX.size(), 0);
+        size_t sphere = 0;
+        for (const SceneBatch &batch : scene.batches) {
+            for (const Mesh &mesh : models[batch.model].meshes) {
+                for (unsigned int i = batch.first; i < batch.first + batch.count; i++, sphere++) {
+                    if (!visible[sphere])
+                        continue;
+                    if (!lodEnabled || mesh.lodCount() == 1) {
+                        lods[sphere] = 0;
+                        continue;
+                    }
+                    glm::vec3 center(sphereX[sphere], sphereY[sphere], sphereZ[sphere]);
+                    float distance = glm::max(glm::length(center - view.position) - sphereRadius[sphere], 1e-3f);
+                    // world space error to pixels
+                    float errorToPixels = scales[sphere] * view.pixelsPerUnit / distance;
+                    lods[sphere] = selectLod(mesh, lods[sphere], errorToPixels);
+                }
+            }
+        }
+
+        transforms.clear();
+        ranges.clear();
+        lodCounts.assign(1, 0);
+        sphere = 0;
+        for (unsigned int b = 0; b < scene.batches.size(); b++) {
+            const SceneBatch &batch = scene.batches[b];
+            for (unsigned int m = 0; m < models[batch.model].meshes.size(); m++) {
+                unsigned int lodCount = models[batch.model].meshes[m].lodCount();
+                if (lodCounts.size() < lodCount)
+                    lodCounts.resize(lodCount, 0);
+                for (unsigned int lod = 0; lod < lodCount; lod++) {
+                    Range range = {b, m, lod, (unsigned int) transforms.size(), 0};
+                    for (unsigned int s = sphere; s < sphere + batch.count; s++) {
+                        if (visible[s] && lods[s] == lod) {
+                            transforms.push_back(worlds[s]);
+                            range.count++;
+                        }
+                    }
+                    if (range.count > 0)
+                        ranges.push_back(range);
+                    lodCounts[lod] += range.count;
+                }
+                sphere += batch.count;
+            }
+        }
+        visibleCount = transforms.size();
+        culledCount = visible.size() - transforms.size();
+    }
+
+private:
+    vector<glm::mat4> worlds;
+    vector<float> scales;
+    vector<uint8_t> lods;
+
+    // coarsest level within the pixel error; going coarser than current needs the margin, going finer doesn't
+    unsigned int selectLod(const Mesh &mesh, unsigned int current, float errorToPixels) const
+    {
+        unsigned int lod = 0;
+        while (lod + 1 < mesh.lodCount() && mesh.lodError(lod + 1) * errorToPixels <= lodPixelError)
+            lod++;
+        while (lod > current && mesh.lodError(lod) * errorToPixels > lodPixelError * (1.0f - lodHysteresis))
+            lod--;
+        return lod;
+    }
+    vector<float> sphereX, sphereY, sphereZ, sphereRadius;
+    vector<uint8_t> visible;
+};
+#endif
@@ -0,0 +1,153 @@
+#ifndef DEFERRED_H
+#define DEFERRED_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/frame_constants.h>
+#include <learnopengl/light_clusters.h>
+#include <learnopengl/shader.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+using namespace std;
+
+// Deferred shading of the lit scene meshes. gbuffer.fs writes world position, normal + shininess and diffuse color
+// of the closest surface per pixel; deferred_light.fs then lights every covered pixel once with the directional
+// light and the torch, and adds each point light only inside the screen rectangle around the sphere where its
+// attenuation is above 5/256 (scissored full-screen triangles, blended additively). Lighting cost follows lit
+// pixels instead of overdraw times light count. With clustered lights the first pass adds the point lights of each
+// pixel's cluster instead.
+// The G-buffer shares the HDR framebuffer's depth buffer, so forward draws after the light pass (moon, fireflies,
+// grass, sky) depth test against the deferred geometry.
+class DeferredRenderer
+{
+public:
+    bool enabled = false;
+    // of the last lightPass()
+    unsigned int pointLightPasses = 0;
+    size_t pointLightPixels = 0;
+
+    // creates the G-buffer around the given depth renderbuffer, needs a current context
+    void init(unsigned int width, unsigned int height, GLuint depthRenderbuffer, Shader &lightShader)
+    {
+        this->width = width;
+        this->height = height;
+        glGenFramebuffers(1, &gBuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, gBuffer);
+        // position needs full float precision at scene distances, normals and 8-bit texture colors don't
+        GLenum formats[ATTACHMENTS] = {GL_RGBA32F, GL_RGBA16F, GL_RGBA8};
+        glGenTextures(ATTACHMENTS, textures);
+        for (unsigned int i = 0; i < ATTACHMENTS; i++) {
+            glBindTexture(GL_TEXTURE_2D, textures[i]);
+            glTexImage2D(GL_TEXTURE_2D, 0, formats[i], width, height, 0, GL_RGBA, GL_FLOAT, NULL);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, textures[i], 0);
+        }
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthRenderbuffer);
+        unsigned int attachments[ATTACHMENTS] = {GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1, GL_COLOR_ATTACHMENT2};
+        glDrawBuffers(ATTACHMENTS, attachments);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+            cout << "ERROR::DEFERRED:: G-buffer framebuffer not complete" << endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        // the light pass triangle comes from gl_VertexID, but core profile draws need a VAO bound
+        glGenVertexArrays(1, &emptyVAO);
+
+        lightShader.use();
+        lightShader.setInt("gPosition", 0);
+        lightShader.setInt("gNormal", 1);
+        lightShader.setInt("gAlbedo", 2);
+        pointLightUniform = lightShader.uniform<int>("pointLight");
+    }
+
+    // binds the G-buffer and clears its color (not depth, that's the HDR framebuffer's to clear)
+    void beginGeometryPass()
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, gBuffer);
+        const GLfloat empty[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+        for (unsigned int i = 0; i < ATTACHMENTS; i++)
+            glClearBufferfv(GL_COLOR, i, empty);
+    }
+
+    // lights the G-buffer into the bound framebuffer (the HDR one), with lights as uploaded in the Lights block, or
+    // the point lights from the clusters (the shader's "clustered" uniform has to agree).
+    // restores depth testing and writing, face culling and no blending afterwards.
+    void lightPass(Shader &lightShader, const LightsBlock &lights, const glm::mat4 &view, const glm::mat4 &projection,
+                   bool clusteredPointLights)
+    {
+        glDisable(GL_DEPTH_TEST);
+        glDepthMask(GL_FALSE);
+        glDisable(GL_CULL_FACE);
+        for (unsigned int i = 0; i < ATTACHMENTS; i++) {
+            glActiveTexture(GL_TEXTURE0 + i);
+            glBindTexture(GL_TEXTURE_2D, textures[i]);
+        }
+        lightShader.use();
+        glBindVertexArray(emptyVAO);
+
+        // directional light and torch reach every covered pixel
+        lightShader.set(pointLightUniform, -1);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+
+        pointLightPasses = 0;
+        pointLightPixels = 0;
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_ONE, GL_ONE);
+        glEnable(GL_SCISSOR_TEST);
+        for (int i = 0; i < lights.nrPointLights && !clusteredPointLights; i++) {
+            const PointLightStd140 &light = lights.pointLights[i];
+            GLint rect[4];
+            if (!scissorRect(light.position, pointLightRadius(light), view, projection, rect))
+                continue;
+            glScissor(rect[0], rect[1], rect[2], rect[3]);
+            lightShader.set(pointLightUniform, i);
+            glDrawArrays(GL_TRIANGLES, 0, 3);
+            pointLightPasses++;
+            pointLightPixels += (size_t) rect[2] * rect[3];
+        }
+        glDisable(GL_SCISSOR_TEST);
+        glDisable(GL_BLEND);
+
+        glBindVertexArray(0);
+        glActiveTexture(GL_TEXTURE0);
+        glEnable(GL_DEPTH_TEST);
+        glDepthMask(GL_TRUE);
+        glEnable(GL_CULL_FACE);
+    }
+
+    void destroy()
+    {
+        glDeleteFramebuffers(1, &gBuffer);
+        glDeleteTextures(ATTACHMENTS, textures);
+        glDeleteVertexArrays(1, &emptyVAO);
+    }
+
+private:
+    static const unsigned int ATTACHMENTS = 3;
+
+    unsigned int width = 0, height = 0;
+    GLuint gBuffer = 0;
+    GLuint textures[ATTACHMENTS] = {0, 0, 0};
+    GLuint emptyVAO = 0;
+    Uniform<int> pointLightUniform;
+
+    // pixel rectangle (x, y, width, height) covering the sphere on screen, false if it's off screen or empty
+    bool scissorRect(const glm::vec3 &center, float radius, const glm::mat4 &view, const glm::mat4 &projection, GLint rect[4]) const
+    {
+        if (radius <= 0.0f)
+            return false;
+        glm::vec2 lower, upper;
+        if (!sphereScreenBounds(glm::vec3(view * glm::vec4(center, 1.0f)), radius, projection, lower, upper))
+            return false;
+        rect[0] = (GLint) floor((lower.x * 0.5f + 0.5f) * width);
+        rect[1] = (GLint) floor((lower.y * 0.5f + 0.5f) * height);
+        rect[2] = (GLint) ceil((upper.x * 0.5f + 0.5f) * width) - rect[0];
+        rect[3] = (GLint) ceil((upper.y * 0.5f + 0.5f) * height) - rect[1];
+        return rect[2] > 0 && rect[3] > 0;
+    }
+};
+#endif
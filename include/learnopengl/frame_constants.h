@@ -0,0 +1,144 @@
+#ifndef FRAME_CONSTANTS_H
+#define FRAME_CONSTANTS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/shader.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+// size of the point light array, has to match MAX_POINT_LIGHTS in model.fs and deferred_light.fs
+const unsigned int MAX_POINT_LIGHTS = 16;
+
+// C++ mirrors of the std140 uniform blocks declared in the shaders. Every vec3 is followed by a float
+// (either a real member or padding) because std140 aligns vec3 to 16 bytes.
+struct DirLightStd140 {
+    glm::vec3 direction; float pad0;
+    glm::vec3 ambient;   float pad1;
+    glm::vec3 diffuse;   float pad2;
+    glm::vec3 specular;  float pad3;
+};
+
+struct PointLightStd140 {
+    glm::vec3 position; float constant;
+    glm::vec3 ambient;  float linear;
+    glm::vec3 diffuse;  float quadratic;
+    glm::vec3 specular; float pad0;
+};
+
+struct SpotLightStd140 {
+    glm::vec3 position;  float constant;
+    glm::vec3 ambient;   float linear;
+    glm::vec3 diffuse;   float quadratic;
+    glm::vec3 specular;  float cutOff;
+    glm::vec3 direction; float outerCutOff;
+};
+
+// layout (std140) uniform Camera, declared by every vertex shader
+struct CameraBlock {
+    glm::mat4 projection;
+    glm::mat4 view;
+    glm::vec3 viewPos; float pad0;
+};
+
+// layout (std140) uniform Lights, declared by model.fs
+struct LightsBlock {
+    DirLightStd140 dirLight;
+    SpotLightStd140 torch;
+    PointLightStd140 pointLights[MAX_POINT_LIGHTS];
+    int nrPointLights;
+    int bTorch; float pad0, pad1;
+};
+
+static_assert(sizeof(DirLightStd140) == 64 && sizeof(PointLightStd140) == 64 && sizeof(SpotLightStd140) == 80,
+              "light structs don't match their std140 layout");
+static_assert(offsetof(CameraBlock, viewPos) == 128 && sizeof(CameraBlock) == 144,
+              "CameraBlock doesn't match its std140 layout");
+static_assert(offsetof(LightsBlock, torch) == 64 && offsetof(LightsBlock, pointLights) == 144
+              && offsetof(LightsBlock, nrPointLights) == 144 + 64 * MAX_POINT_LIGHTS
+              && offsetof(LightsBlock, bTorch) == 148 + 64 * MAX_POINT_LIGHTS,
+              "LightsBlock doesn't match its std140 layout");
+
+// point lights are cut off where they add less than this to a color channel (deferred and clustered lighting)
+const float POINT_LIGHT_CUTOFF = 5.0f / 256.0f;
+
+// distance at which the light's attenuated color drops below POINT_LIGHT_CUTOFF, infinite if it never does
+inline float pointLightRadius(const PointLightStd140 &light)
+{
+    glm::vec3 color = light.ambient + light.diffuse + light.specular;
+    float brightest = std::max(color.r, std::max(color.g, color.b));
+    // solve constant + linear * d + quadratic * d^2 = brightest / cutoff
+    float c = light.constant - brightest / POINT_LIGHT_CUTOFF;
+    if (c >= 0.0f)
+        return 0.0f;
+    if (light.quadratic > 0.0f)
+        return (-light.linear + std::sqrt(light.linear * light.linear - 4.0f * light.quadratic * c)) / (2.0f * light.quadratic);
+    if (light.linear > 0.0f)
+        return -c / light.linear;
+    return INFINITY;
+}
+
+// Per-frame constants shared by all programs. Both blocks live in one uniform buffer, which is written with a single
+// glBufferSubData per frame and bound to fixed binding points, so programs never get these as plain uniforms.
+class FrameConstants
+{
+public:
+    static const GLuint CAMERA_BINDING = 0;
+    static const GLuint LIGHTS_BINDING = 1;
+
+    CameraBlock camera;
+    LightsBlock lights;
+
+    // creates the buffer, has to run after the GL context is up
+    void init()
+    {
+        // the lights block has to start at a multiple of the UBO offset alignment
+        GLint alignment = 256;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        lightsOffset = (sizeof(CameraBlock) + alignment - 1) / alignment * alignment;
+        staging.assign(lightsOffset + sizeof(LightsBlock), 0);
+        camera = CameraBlock();
+        lights = LightsBlock();
+
+        glGenBuffers(1, &UBO);
+        glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+        glBufferData(GL_UNIFORM_BUFFER, staging.size(), nullptr, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        glBindBufferRange(GL_UNIFORM_BUFFER, CAMERA_BINDING, UBO, 0, sizeof(CameraBlock));
+        glBindBufferRange(GL_UNIFORM_BUFFER, LIGHTS_BINDING, UBO, lightsOffset, sizeof(LightsBlock));
+    }
+
+    // connects the program's Camera and Lights blocks (if it has them) to our binding points
+    static void bind(Shader &shader)
+    {
+        shader.bindUniformBlock("Camera", CAMERA_BINDING);
+        shader.bindUniformBlock("Lights", LIGHTS_BINDING);
+    }
+
+    // uploads camera and lights in one buffer update
+    void upload()
+    {
+        memcpy(staging.data(), &camera, sizeof(CameraBlock));
+        memcpy(staging.data() + lightsOffset, &lights, sizeof(LightsBlock));
+        glBindBuffer(GL_UNIFORM_BUFFER, UBO);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, staging.size(), staging.data());
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+
+    void destroy()
+    {
+        glDeleteBuffers(1, &UBO);
+        UBO = 0;
+    }
+
+private:
+    unsigned int UBO = 0;
+    size_t lightsOffset = 0;
+    std::vector<char> staging;
+};
+#endif
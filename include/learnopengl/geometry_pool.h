@@ -0,0 +1,212 @@
+#ifndef GEOMETRY_POOL_H
+#define GEOMETRY_POOL_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/vertex_format.h>
+
+#include <algorithm>
+#include <memory>
+#include <vector>
+using namespace std;
+
+// first of the four attribute locations holding the per-instance model matrix (aInstanceModel in the shaders)
+const unsigned int INSTANCE_MATRIX_LOCATION = 5;
+// attribute location of the per-instance draw id of indirect draws (aDrawID, see IndirectDraws)
+const unsigned int DRAW_ID_LOCATION = 9;
+
+// a VAO, shared by every mesh drawing from it, and where its instance matrix attributes currently read from
+struct VertexArrayState {
+    GLuint vao = 0;
+    GLuint instanceBuffer = 0;
+    size_t instanceOffset = 0;
+    // the instance matrix attribute arrays are enabled, otherwise the draw id array is
+    bool instanceArrays = true;
+
+    // points the instance matrix attributes at the matrices starting at offset bytes into buffer.
+    // only when the source actually changes, the VAO is bound then (and left bound).
+    void setInstanceSource(GLuint buffer, size_t offset)
+    {
+        setInstanceArrays(true);
+        if (buffer == instanceBuffer && offset == instanceOffset)
+            return;
+        instanceBuffer = buffer;
+        instanceOffset = offset;
+        glBindVertexArray(vao);
+        glBindBuffer(GL_ARRAY_BUFFER, buffer);
+        for (unsigned int column = 0; column < 4; column++)
+            glVertexAttribPointer(INSTANCE_MATRIX_LOCATION + column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(offset + column * sizeof(glm::vec4)));
+    }
+
+    // switches the per-instance attributes between the instance matrices (enabled) and the draw ids of indirect
+    // draws. each kind of draw instances past the end of the other one's buffer, disabled arrays read a constant
+    // instead. the VAO is bound when the state changes (and left bound).
+    void setInstanceArrays(bool enabled)
+    {
+        if (enabled == instanceArrays)
+            return;
+        instanceArrays = enabled;
+        glBindVertexArray(vao);
+        for (unsigned int column = 0; column < 4; column++) {
+            if (enabled)
+                glEnableVertexAttribArray(INSTANCE_MATRIX_LOCATION + column);
+            else
+                glDisableVertexAttribArray(INSTANCE_MATRIX_LOCATION + column);
+        }
+        if (enabled)
+            glDisableVertexAttribArray(DRAW_ID_LOCATION);
+        else
+            glEnableVertexAttribArray(DRAW_ID_LOCATION);
+    }
+};
+
+// where a mesh's vertices and indices ended up
+struct GeometryAllocation {
+    shared_ptr<VertexArrayState> vertexArray;
+    GLuint vertexBuffer = 0;
+    GLuint indexBuffer = 0;
+    // added to every index, the mesh's first vertex in the vertex buffer
+    GLint baseVertex = 0;
+    // byte offset of the mesh's first index in the index buffer
+    size_t indexOffset = 0;
+};
+
+// Suballocates static meshes from a few large vertex/index buffer arenas, one VAO per vertex layout, so meshes of
+// the same layout draw from the same VAO (with glDrawElementsBaseVertex) instead of binding a VAO each.
+// Allocations live as long as the pool, static geometry is never freed one by one.
+class GeometryPool
+{
+public:
+    // default arena sizes, a mesh that doesn't fit gets an arena of its own size
+    static const size_t ARENA_VERTEX_BYTES = 16 << 20;
+    static const size_t ARENA_INDEX_BYTES = 8 << 20;
+
+    // set to false before loading to give every mesh its own VAO and buffers again
+    static bool enabled;
+
+    static GeometryPool &instance()
+    {
+        static GeometryPool pool;
+        return pool;
+    }
+
+    // copies the vertices (already in the given layout) and indices into an arena, on the thread owning the GL context
+    GeometryAllocation allocate(const VertexLayout &layout, const vector<unsigned char> &vertexData,
+                                const vector<unsigned char> &indexData)
+    {
+        Arena *arena = nullptr;
+        for (Arena &candidate : arenas)
+        {
+            if (sameFormat(candidate.layout, layout)
+                && candidate.vertexBytes + vertexData.size() <= candidate.vertexCapacity
+                && candidate.indexBytes + indexData.size() <= candidate.indexCapacity)
+            {
+                arena = &candidate;
+                break;
+            }
+        }
+        if (!arena)
+            arena = createArena(layout, max(ARENA_VERTEX_BYTES, vertexData.size()), max(ARENA_INDEX_BYTES, indexData.size()));
+
+        GeometryAllocation allocation;
+        allocation.vertexArray = arena->vertexArray;
+        allocation.vertexBuffer = arena->vertexBuffer;
+        allocation.indexBuffer = arena->indexBuffer;
+        allocation.baseVertex = arena->vertexBytes / layout.stride;
+        allocation.indexOffset = arena->indexBytes;
+
+        // the element buffer binding is VAO state, so upload through the arena's VAO
+        glBindVertexArray(arena->vertexArray->vao);
+        glBindBuffer(GL_ARRAY_BUFFER, arena->vertexBuffer);
+        glBufferSubData(GL_ARRAY_BUFFER, arena->vertexBytes, vertexData.size(), vertexData.data());
+        glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, arena->indexBytes, indexData.size(), indexData.data());
+        glBindVertexArray(0);
+
+        arena->vertexBytes += vertexData.size();
+        // keep every mesh's indices 4-byte aligned, whatever the index type of the one before
+        arena->indexBytes += (indexData.size() + 3) & ~(size_t) 3;
+        return allocation;
+    }
+
+    unsigned int arenaCount() const
+    {
+        return arenas.size();
+    }
+
+    // bytes in use and allocated, over all arenas
+    size_t usedBytes() const
+    {
+        size_t bytes = 0;
+        for (const Arena &arena : arenas)
+            bytes += arena.vertexBytes + arena.indexBytes;
+        return bytes;
+    }
+
+    size_t capacityBytes() const
+    {
+        size_t bytes = 0;
+        for (const Arena &arena : arenas)
+            bytes += arena.vertexCapacity + arena.indexCapacity;
+        return bytes;
+    }
+
+    // deletes the arenas, every mesh allocated from them is unusable afterwards
+    void clear()
+    {
+        for (Arena &arena : arenas)
+        {
+            glDeleteVertexArrays(1, &arena.vertexArray->vao);
+            glDeleteBuffers(1, &arena.vertexBuffer);
+            glDeleteBuffers(1, &arena.indexBuffer);
+        }
+        arenas.clear();
+    }
+
+private:
+    struct Arena {
+        VertexLayout layout;
+        shared_ptr<VertexArrayState> vertexArray;
+        GLuint vertexBuffer;
+        GLuint indexBuffer;
+        size_t vertexBytes, vertexCapacity;
+        size_t indexBytes, indexCapacity;
+    };
+    vector<Arena> arenas;
+
+    GeometryPool() {}
+
+    static bool sameFormat(const VertexLayout &a, const VertexLayout &b)
+    {
+        return a.attributes == b.attributes && a.packed == b.packed && a.stride == b.stride;
+    }
+
+    Arena *createArena(const VertexLayout &layout, size_t vertexCapacity, size_t indexCapacity)
+    {
+        Arena arena;
+        arena.layout = layout;
+        arena.vertexArray = make_shared<VertexArrayState>();
+        arena.vertexBytes = arena.indexBytes = 0;
+        // whole vertices only, so base vertices stay exact
+        arena.vertexCapacity = vertexCapacity / layout.stride * layout.stride;
+        arena.indexCapacity = indexCapacity;
+
+        glGenVertexArrays(1, &arena.vertexArray->vao);
+        glGenBuffers(1, &arena.vertexBuffer);
+        glGenBuffers(1, &arena.indexBuffer);
+        glBindVertexArray(arena.vertexArray->vao);
+        glBindBuffer(GL_ARRAY_BUFFER, arena.vertexBuffer);
+        glBufferData(GL_ARRAY_BUFFER, arena.vertexCapacity, nullptr, GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, arena.indexBuffer);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, arena.indexCapacity, nullptr, GL_STATIC_DRAW);
+        layout.setAttributePointers();
+        glBindVertexArray(0);
+
+        arenas.push_back(arena);
+        return &arenas.back();
+    }
+};
+
+bool GeometryPool::enabled = true;
+#endif
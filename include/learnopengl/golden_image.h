@@ -0,0 +1,149 @@
+#ifndef GOLDEN_IMAGE_H
+#define GOLDEN_IMAGE_H
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+using namespace std;
+
+// 8-bit RGB image, rows top to bottom, stored as binary PPM (P6) so no image writer library is needed
+struct Image {
+    unsigned int width = 0, height = 0;
+    vector<unsigned char> rgb;
+
+    // the color buffer of the bound read framebuffer
+    static Image readFramebuffer(unsigned int width, unsigned int height)
+    {
+        Image image;
+        image.width = width;
+        image.height = height;
+        image.rgb.resize(width * height * 3);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, image.rgb.data());
+        // GL reads bottom row first
+        vector<unsigned char> row(width * 3);
+        for (unsigned int y = 0; y < height / 2; y++) {
+            unsigned char *top = &image.rgb[y * width * 3], *bottom = &image.rgb[(height - 1 - y) * width * 3];
+            memcpy(row.data(), top, row.size());
+            memcpy(top, bottom, row.size());
+            memcpy(bottom, row.data(), row.size());
+        }
+        return image;
+    }
+
+    bool read(const string &path)
+    {
+        ifstream in(path, ios::binary);
+        string magic;
+        unsigned int maxValue = 0;
+        if (!(in >> magic >> width >> height >> maxValue) || magic != "P6" || maxValue != 255)
+            return false;
+        in.get(); // the single whitespace before the pixels
+        rgb.resize(width * height * 3);
+        return (bool) in.read((char *) rgb.data(), rgb.size());
+    }
+
+    bool write(const string &path) const
+    {
+        ofstream out(path, ios::binary);
+        out << "P6\n" << width << " " << height << "\n255\n";
+        out.write((const char *) rgb.data(), rgb.size());
+        if (!out) {
+            cout << "ERROR::GOLDEN_IMAGE:: can't write " << path << endl;
+            return false;
+        }
+        return true;
+    }
+};
+
+// Compares a render against its reference the way a viewer would notice: per pixel, the difference is the
+// brightness weighted YIQ distance (Kotsarenko & Ramos, "Measuring perceived color difference using YIQ NTSC
+// transmission color space in mobile applications"), and only pixels above threshold (0 to 1 of the largest
+// possible distance) count as different. The heatmap shows the reference faded to gray, different pixels in red
+// to yellow by how far off they are.
+struct ImageDiff {
+    unsigned int differentPixels = 0;
+    float maxDelta = 0.0f;
+    Image heatmap;
+
+    static ImageDiff compare(const Image &reference, const Image &actual, float threshold)
+    {
+        ImageDiff diff;
+        if (reference.width != actual.width || reference.height != actual.height) {
+            diff.differentPixels = max(reference.width * reference.height, actual.width * actual.height);
+            diff.maxDelta = 1.0f;
+            return diff;
+        }
+        // distance of black to white
+        const float MAX_DELTA = 35215.0f;
+        diff.heatmap = reference;
+        for (size_t p = 0; p < reference.rgb.size(); p += 3) {
+            float delta = yiqDistance(&reference.rgb[p], &actual.rgb[p]) / MAX_DELTA;
+            diff.maxDelta = max(diff.maxDelta, delta);
+            unsigned char *pixel = &diff.heatmap.rgb[p];
+            if (delta > threshold * threshold) {
+                diff.differentPixels++;
+                float strength = min(1.0f, sqrt(delta));
+                pixel[0] = 255;
+                pixel[1] = (unsigned char) (strength * 255.0f);
+                pixel[2] = 0;
+            } else {
+                unsigned char gray = (unsigned char) (255.0f - (255.0f - luminance(pixel)) * 0.1f);
+                pixel[0] = pixel[1] = pixel[2] = gray;
+            }
+        }
+        diff.maxDelta = sqrt(diff.maxDelta);
+        return diff;
+    }
+
+private:
+    static float luminance(const unsigned char *c)
+    {
+        return c[0] * 0.29889531f + c[1] * 0.58662247f + c[2] * 0.11448223f;
+    }
+
+    static float yiqDistance(const unsigned char *a, const unsigned char *b)
+    {
+        float y = luminance(a) - luminance(b);
+        float i = (a[0] - b[0]) * 0.59597799f - (a[1] - b[1]) * 0.27417610f - (a[2] - b[2]) * 0.32180189f;
+        float q = (a[0] - b[0]) * 0.21147017f - (a[1] - b[1]) * 0.52261711f + (a[2] - b[2]) * 0.31114694f;
+        return 0.5053f * y * y + 0.299f * i * i + 0.1957f * q * q;
+    }
+};
+
+// a camera pose to capture: a name (the reference is <name>.ppm) and the ProgramState file to render it from
+struct GoldenPose {
+    string name;
+    string stateFile;
+};
+
+// poses.txt of a golden image directory, "<name> <state file>" per line, # starts a comment
+inline vector<GoldenPose> loadGoldenPoses(const string &directory)
+{
+    vector<GoldenPose> poses;
+    ifstream in(directory + "/poses.txt");
+    if (!in) {
+        cout << "ERROR::GOLDEN_IMAGE:: can't read " << directory << "/poses.txt" << endl;
+        return poses;
+    }
+    string line;
+    while (getline(in, line)) {
+        if (line.empty() || line[0] == '#')
+            continue;
+        istringstream words(line);
+        GoldenPose pose;
+        if (words >> pose.name >> pose.stateFile) {
+            pose.stateFile = directory + "/" + pose.stateFile;
+            poses.push_back(pose);
+        }
+    }
+    return poses;
+}
+#endif
@@ -0,0 +1,185 @@
+#ifndef INDIRECT_DRAW_H
+#define INDIRECT_DRAW_H
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/geometry_pool.h>
+#include <learnopengl/shader.h>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <vector>
+using namespace std;
+
+// not part of the GL 3.3 headers
+#ifndef GL_DRAW_INDIRECT_BUFFER
+#define GL_DRAW_INDIRECT_BUFFER 0x8F3F
+#endif
+
+// layout glMultiDrawElementsIndirect reads its commands in
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    // in indices, not bytes
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+// Per-instance draw records in a texture buffer, and submission of runs of draws sharing all GL state with a single
+// glMultiDrawElementsIndirect. The context is GL 3.3, so the multi-draw (and base instance) entry points are loaded
+// by hand when the driver has ARB_multi_draw_indirect and ARB_base_instance; without them the commands are issued
+// one by one.
+//
+// A record is RECORD_TEXELS RGBA32F texels: the model matrix columns, then (shininess, 0, 0, 0). Shaders find
+// their record at aDrawID + drawOffset: aDrawID (location DRAW_ID_LOCATION) reads a buffer holding 0, 1, 2, ...
+// once per instance, so with base instances it is baseInstance + gl_InstanceID, and the fallback loop puts
+// baseInstance in the drawOffset uniform instead.
+class IndirectDraws
+{
+public:
+    static const unsigned int RECORD_TEXELS = 5;
+    // texture unit of the record buffer, above the units mesh textures use
+    static const GLuint RECORD_TEXTURE_UNIT = 15;
+
+    // draw scene meshes through the records at all
+    bool enabled = true;
+    // when supported, use glMultiDrawElementsIndirect instead of the fallback loop
+    bool multiDraw = true;
+
+    // loads the entry points and creates the buffers, needs a current context
+    void init()
+    {
+        if (glfwExtensionSupported("GL_ARB_multi_draw_indirect") && glfwExtensionSupported("GL_ARB_base_instance"))
+            multiDrawElementsIndirect = (MultiDrawElementsIndirectProc) glfwGetProcAddress("glMultiDrawElementsIndirect");
+        if (!multiDrawElementsIndirect)
+            cout << "INFO::INDIRECT_DRAW:: glMultiDrawElementsIndirect not available, drawing command by command" << endl;
+
+        glGenBuffers(1, &recordBuffer);
+        glGenTextures(1, &recordTexture);
+        glGenBuffers(1, &drawIdBuffer);
+        glGenBuffers(1, &commandBuffer);
+        glBindBuffer(GL_TEXTURE_BUFFER, recordBuffer);
+        glBufferData(GL_TEXTURE_BUFFER, RECORD_TEXELS * sizeof(glm::vec4), nullptr, GL_STREAM_DRAW);
+        glBindTexture(GL_TEXTURE_BUFFER, recordTexture);
+        glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, recordBuffer);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+        growDrawIds(1024);
+    }
+
+    bool multiDrawSupported() const
+    {
+        return multiDrawElementsIndirect != nullptr;
+    }
+
+    bool usingMultiDraw() const
+    {
+        return multiDraw && multiDrawSupported();
+    }
+
+    // feeds aDrawID of a VAO, once per VAO (meshes of the GeometryPool share theirs). the array starts disabled,
+    // VertexArrayState::setInstanceArrays enables it for indirect draws only
+    void setupVertexArray(GLuint vao)
+    {
+        glBindVertexArray(vao);
+        glBindBuffer(GL_ARRAY_BUFFER, drawIdBuffer);
+        glVertexAttribIPointer(DRAW_ID_LOCATION, 1, GL_INT, sizeof(GLint), (void*) 0);
+        glVertexAttribDivisor(DRAW_ID_LOCATION, 1);
+        glBindVertexArray(0);
+    }
+
+    // replaces the records, record i gets transforms[i] and materials[i]
+    void uploadRecords(const vector<glm::mat4> &transforms, const vector<float> &materials)
+    {
+        records.resize(transforms.size() * RECORD_TEXELS);
+        for (size_t i = 0; i < transforms.size(); i++) {
+            glm::vec4 *record = &records[i * RECORD_TEXELS];
+            for (int column = 0; column < 4; column++)
+                record[column] = transforms[i][column];
+            record[4] = glm::vec4(materials[i], 0.0f, 0.0f, 0.0f);
+        }
+        glBindBuffer(GL_TEXTURE_BUFFER, recordBuffer);
+        // orphan, last frame's draws may still read the old records
+        glBufferData(GL_TEXTURE_BUFFER, records.size() * sizeof(glm::vec4), nullptr, GL_STREAM_DRAW);
+        glBufferSubData(GL_TEXTURE_BUFFER, 0, records.size() * sizeof(glm::vec4), records.data());
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+        // every instance needs a draw id, also in the fallback loop where they start at 0 for each draw
+        growDrawIds(transforms.size());
+    }
+
+    // points the drawData sampler of a program at RECORD_TEXTURE_UNIT, once after building it. until then it's on
+    // unit 0 with the program's 2D textures, and draws with both sampler types on one unit fail.
+    static void bindSampler(Shader &shader)
+    {
+        shader.use();
+        shader.setInt("drawData", RECORD_TEXTURE_UNIT);
+    }
+
+    // binds the records to RECORD_TEXTURE_UNIT, leaves that unit active
+    void bindRecords()
+    {
+        glActiveTexture(GL_TEXTURE0 + RECORD_TEXTURE_UNIT);
+        glBindTexture(GL_TEXTURE_BUFFER, recordTexture);
+    }
+
+    // draws the commands with the bound VAO and program, drawOffsetLocation is the program's drawOffset uniform.
+    // returns the number of GL draw calls it took.
+    unsigned int draw(const vector<DrawElementsIndirectCommand> &commands, GLenum indexType, GLint drawOffsetLocation)
+    {
+        if (commands.empty())
+            return 0;
+        if (usingMultiDraw()) {
+            glUniform1i(drawOffsetLocation, 0);
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+            glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(DrawElementsIndirectCommand), commands.data(), GL_STREAM_DRAW);
+            multiDrawElementsIndirect(GL_TRIANGLES, indexType, nullptr, commands.size(), 0);
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+            return 1;
+        }
+        unsigned int indexSize = indexType == GL_UNSIGNED_BYTE ? 1 : indexType == GL_UNSIGNED_SHORT ? 2 : 4;
+        for (const DrawElementsIndirectCommand &command : commands) {
+            glUniform1i(drawOffsetLocation, command.baseInstance);
+            glDrawElementsInstancedBaseVertex(GL_TRIANGLES, command.count, indexType, (void*)((size_t) command.firstIndex * indexSize),
+                                              command.instanceCount, command.baseVertex);
+        }
+        return commands.size();
+    }
+
+    void destroy()
+    {
+        glDeleteBuffers(1, &recordBuffer);
+        glDeleteTextures(1, &recordTexture);
+        glDeleteBuffers(1, &drawIdBuffer);
+        glDeleteBuffers(1, &commandBuffer);
+    }
+
+private:
+    typedef void (APIENTRYP MultiDrawElementsIndirectProc)(GLenum mode, GLenum type, const void *indirect, GLsizei drawCount, GLsizei stride);
+    MultiDrawElementsIndirectProc multiDrawElementsIndirect = nullptr;
+
+    GLuint recordBuffer = 0, recordTexture = 0;
+    GLuint drawIdBuffer = 0;
+    GLuint commandBuffer = 0;
+    size_t drawIdCount = 0;
+    vector<glm::vec4> records;
+
+    // the VAOs keep pointing at drawIdBuffer, only its storage is replaced
+    void growDrawIds(size_t count)
+    {
+        if (count <= drawIdCount)
+            return;
+        drawIdCount = max(count, drawIdCount * 2);
+        vector<GLint> ids(drawIdCount);
+        for (size_t i = 0; i < ids.size(); i++)
+            ids[i] = i;
+        glBindBuffer(GL_ARRAY_BUFFER, drawIdBuffer);
+        glBufferData(GL_ARRAY_BUFFER, ids.size() * sizeof(GLint), ids.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+};
+#endif
@@ -0,0 +1,274 @@
+#ifndef LIGHT_CLUSTERS_H
+#define LIGHT_CLUSTERS_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/frame_constants.h>
+#include <learnopengl/shader.h>
+#include <learnopengl/thread_pool.h>
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <functional>
+#include <vector>
+using namespace std;
+
+// near plane distance of a glm::perspective projection
+inline float projectionNear(const glm::mat4 &projection)
+{
+    return projection[3][2] / (projection[2][2] - 1.0f);
+}
+
+// far plane distance of a glm::perspective projection
+inline float projectionFar(const glm::mat4 &projection)
+{
+    return projection[3][2] / (projection[2][2] + 1.0f);
+}
+
+// normalized device xy rectangle covering a view space sphere, false if none of it is in front of the near plane.
+// a sphere crossing the near plane covers the whole screen (projecting its corners would flip them).
+inline bool sphereScreenBounds(const glm::vec3 &center, float radius, const glm::mat4 &projection, glm::vec2 &lower, glm::vec2 &upper)
+{
+    // the camera looks down -z
+    float nearPlane = projectionNear(projection);
+    if (center.z - radius > -nearPlane)
+        return false;
+    lower = glm::vec2(-1.0f);
+    upper = glm::vec2(1.0f);
+    if (std::isinf(radius) || center.z + radius > -nearPlane)
+        return true;
+    lower = glm::vec2(1.0f);
+    upper = glm::vec2(-1.0f);
+    for (int corner = 0; corner < 8; corner++) {
+        glm::vec3 p = center + radius * glm::vec3(corner & 1 ? 1.0f : -1.0f, corner & 2 ? 1.0f : -1.0f, corner & 4 ? 1.0f : -1.0f);
+        glm::vec4 clip = projection * glm::vec4(p, 1.0f);
+        glm::vec2 ndc = glm::vec2(clip.x, clip.y) / clip.w;
+        lower = glm::min(lower, ndc);
+        upper = glm::max(upper, ndc);
+    }
+    lower = glm::max(lower, glm::vec2(-1.0f));
+    upper = glm::min(upper, glm::vec2(1.0f));
+    return lower.x < upper.x && lower.y < upper.y;
+}
+
+// Clustered point lights: the view frustum is cut into GRID_X * GRID_Y screen tiles times GRID_Z depth slices
+// (exponentially spaced between the near and far plane), and every frame each light's bounding sphere (see
+// pointLightRadius) is binned into the clusters its screen rectangle and depth range touch. Shaders find their
+// cluster from gl_FragCoord and view depth and only loop over its lights, so the light count isn't bounded by
+// MAX_POINT_LIGHTS and a fragment pays for the lights near it only.
+//
+// Binning runs on a ThreadPool when build() gets one: the lights' cluster boxes are computed in parallelFor chunks,
+// then the counting sort is split by depth slice, every chunk counting and filling the clusters of its own slices
+// only (scanning all boxes, but skipping the ones outside its slices). Within a cluster the lights stay in index
+// order, so the lists are the same as a single threaded build's.
+//
+// Three buffer textures hold the data: the lights (4 RGBA32F texels each, laid out like PointLightStd140), an
+// RG32UI (offset, count) per cluster into the light index list, and the R32UI index list itself.
+class LightClusters
+{
+public:
+    static const unsigned int GRID_X = 16;
+    static const unsigned int GRID_Y = 9;
+    static const unsigned int GRID_Z = 24;
+    static const unsigned int CLUSTER_COUNT = GRID_X * GRID_Y * GRID_Z;
+    // units of the lights, ranges and indices, below the IndirectDraws records
+    static const GLuint LIGHTS_TEXTURE_UNIT = 12;
+    static const GLuint RANGES_TEXTURE_UNIT = 13;
+    static const GLuint INDICES_TEXTURE_UNIT = 14;
+
+    bool enabled = false;
+    // of the last build()
+    unsigned int lightCount = 0;
+    unsigned int indexCount = 0;
+    unsigned int maxClusterLights = 0;
+    double buildMilliseconds = 0.0;
+
+    // creates the buffers, needs a current context
+    void init()
+    {
+        GLenum formats[BUFFERS] = {GL_RGBA32F, GL_RG32UI, GL_R32UI};
+        glGenBuffers(BUFFERS, buffers);
+        glGenTextures(BUFFERS, textures);
+        for (unsigned int i = 0; i < BUFFERS; i++) {
+            glBindBuffer(GL_TEXTURE_BUFFER, buffers[i]);
+            glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW);
+            glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+            glTexBuffer(GL_TEXTURE_BUFFER, formats[i], buffers[i]);
+        }
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+
+    // bins the lights into the clusters of the view, on pool's workers if there is one, and uploads everything
+    void build(const vector<PointLightStd140> &lights, const glm::mat4 &view, const glm::mat4 &projection,
+               unsigned int width, unsigned int height, ThreadPool *pool = nullptr)
+    {
+        auto start = chrono::steady_clock::now();
+        this->width = width;
+        this->height = height;
+        nearPlane = projectionNear(projection);
+        farPlane = projectionFar(projection);
+        sliceScale = GRID_Z / log(farPlane / nearPlane);
+        auto run = [pool](size_t count, const function<void(size_t, size_t)> &body) {
+            if (pool)
+                pool->parallelFor(count, body);
+            else if (count > 0)
+                body(0, count);
+        };
+
+        // the cluster box of every light, light is NO_LIGHT for the ones no cluster sees
+        boxes.resize(lights.size());
+        run(lights.size(), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++)
+                boxes[i].light = clusterBox(lights[i], view, projection, boxes[i]) ? i : NO_LIGHT;
+        });
+
+        // counting sort of the light indices by cluster, the slices [begin, end) of a chunk belong to it alone
+        ranges.assign(CLUSTER_COUNT * 2, 0);
+        run(GRID_Z, [&](size_t begin, size_t end) {
+            for (const Box &box : boxes)
+                forClusters(box, begin, end, [&](unsigned int cluster) { ranges[cluster * 2 + 1]++; });
+        });
+        indexCount = 0;
+        maxClusterLights = 0;
+        for (unsigned int cluster = 0; cluster < CLUSTER_COUNT; cluster++) {
+            ranges[cluster * 2] = indexCount;
+            indexCount += ranges[cluster * 2 + 1];
+            maxClusterLights = max(maxClusterLights, ranges[cluster * 2 + 1]);
+            ranges[cluster * 2 + 1] = 0;
+        }
+        indices.resize(max(indexCount, 1u));
+        run(GRID_Z, [&](size_t begin, size_t end) {
+            for (const Box &box : boxes)
+                forClusters(box, begin, end, [&](unsigned int cluster) {
+                    indices[ranges[cluster * 2] + ranges[cluster * 2 + 1]++] = box.light;
+                });
+        });
+        lightCount = lights.size();
+
+        // orphaned, last frame's draws may still read the old contents
+        upload(0, lights.empty() ? nullptr : lights.data(), max<size_t>(lights.size(), 1) * sizeof(PointLightStd140));
+        upload(1, ranges.data(), ranges.size() * sizeof(GLuint));
+        upload(2, indices.data(), indices.size() * sizeof(GLuint));
+        buildMilliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    }
+
+    // points the cluster samplers of a program at their units, once after building it (see
+    // IndirectDraws::bindSampler)
+    static void bindSamplers(Shader &shader)
+    {
+        shader.use();
+        shader.setInt("clusterLights", LIGHTS_TEXTURE_UNIT);
+        shader.setInt("clusterRanges", RANGES_TEXTURE_UNIT);
+        shader.setInt("clusterIndices", INDICES_TEXTURE_UNIT);
+    }
+
+    // binds the buffers to their units and sets the cluster uniforms of a program using them, leaves it in use
+    void apply(Shader &shader)
+    {
+        glActiveTexture(GL_TEXTURE0 + LIGHTS_TEXTURE_UNIT);
+        glBindTexture(GL_TEXTURE_BUFFER, textures[0]);
+        glActiveTexture(GL_TEXTURE0 + RANGES_TEXTURE_UNIT);
+        glBindTexture(GL_TEXTURE_BUFFER, textures[1]);
+        glActiveTexture(GL_TEXTURE0 + INDICES_TEXTURE_UNIT);
+        glBindTexture(GL_TEXTURE_BUFFER, textures[2]);
+        glActiveTexture(GL_TEXTURE0);
+
+        shader.use();
+        shader.setBool("clustered", enabled);
+        glUniform3i(shader.location("clusterGrid"), GRID_X, GRID_Y, GRID_Z);
+        shader.setVec2("clusterTileSize", (float) width / GRID_X, (float) height / GRID_Y);
+        shader.setFloat("clusterNear", nearPlane);
+        shader.setFloat("clusterSliceScale", sliceScale);
+    }
+
+    void destroy()
+    {
+        glDeleteBuffers(BUFFERS, buffers);
+        glDeleteTextures(BUFFERS, textures);
+    }
+
+private:
+    static const unsigned int BUFFERS = 3;
+    static const unsigned int NO_LIGHT = UINT_MAX;
+
+    // inclusive cluster coordinate ranges a light touches
+    struct Box {
+        unsigned int light;
+        unsigned int min[3], max[3];
+    };
+
+    GLuint buffers[BUFFERS] = {0, 0, 0};
+    GLuint textures[BUFFERS] = {0, 0, 0};
+    unsigned int width = 1, height = 1;
+    float nearPlane = 0.1f, farPlane = 1000.0f, sliceScale = 1.0f;
+    vector<Box> boxes;
+    // (offset, count) per cluster
+    vector<GLuint> ranges;
+    vector<GLuint> indices;
+
+    static unsigned int clusterIndex(unsigned int x, unsigned int y, unsigned int z)
+    {
+        return (z * GRID_Y + y) * GRID_X + x;
+    }
+
+    // calls visit with every cluster of box in the depth slices [begin, end)
+    template<typename Visit>
+    static void forClusters(const Box &box, size_t begin, size_t end, Visit visit)
+    {
+        if (box.light == NO_LIGHT)
+            return;
+        unsigned int first = max<size_t>(box.min[2], begin), last = min<size_t>(box.max[2] + 1, end);
+        for (unsigned int z = first; z < last; z++)
+            for (unsigned int y = box.min[1]; y <= box.max[1]; y++)
+                for (unsigned int x = box.min[0]; x <= box.max[0]; x++)
+                    visit(clusterIndex(x, y, z));
+    }
+
+    // depth slice of a view distance, the same as the shaders compute
+    unsigned int slice(float distance) const
+    {
+        if (distance <= nearPlane)
+            return 0;
+        return min((unsigned int) (log(distance / nearPlane) * sliceScale), GRID_Z - 1);
+    }
+
+    bool clusterBox(const PointLightStd140 &light, const glm::mat4 &view, const glm::mat4 &projection, Box &box) const
+    {
+        float radius = pointLightRadius(light);
+        if (radius <= 0.0f)
+            return false;
+        glm::vec3 center = glm::vec3(view * glm::vec4(light.position, 1.0f));
+        glm::vec2 lower, upper;
+        if (!sphereScreenBounds(center, radius, projection, lower, upper))
+            return false;
+        if (std::isinf(radius)) {
+            box.min[2] = 0;
+            box.max[2] = GRID_Z - 1;
+        } else {
+            if (-center.z - radius > farPlane)
+                return false;
+            box.min[2] = slice(-center.z - radius);
+            box.max[2] = slice(-center.z + radius);
+        }
+        // normalized device coordinates to tiles
+        box.min[0] = min((unsigned int) ((lower.x * 0.5f + 0.5f) * GRID_X), GRID_X - 1);
+        box.max[0] = min((unsigned int) ((upper.x * 0.5f + 0.5f) * GRID_X), GRID_X - 1);
+        box.min[1] = min((unsigned int) ((lower.y * 0.5f + 0.5f) * GRID_Y), GRID_Y - 1);
+        box.max[1] = min((unsigned int) ((upper.y * 0.5f + 0.5f) * GRID_Y), GRID_Y - 1);
+        return true;
+    }
+
+    void upload(unsigned int buffer, const void *data, size_t bytes)
+    {
+        glBindBuffer(GL_TEXTURE_BUFFER, buffers[buffer]);
+        glBufferData(GL_TEXTURE_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+        if (data)
+            glBufferSubData(GL_TEXTURE_BUFFER, 0, bytes, data);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+};
+#endif
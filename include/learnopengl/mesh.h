@@ -6,48 +6,148 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include <learnopengl/geometry_pool.h>
 #include <learnopengl/shader.h>
+#include <learnopengl/vertex_format.h>
 
 #include <string>
 #include <vector>
 using namespace std;
 
-struct Vertex {
-    // position
-    glm::vec3 Position;
-    // normal
-    glm::vec3 Normal;
-    // texCoords
-    glm::vec2 TexCoords;
-    // tangent
-    glm::vec3 Tangent;
-    // bitangent
-    glm::vec3 Bitangent;
-};
 
+// kind of a mesh texture, selects the sampler it's bound to (see textureTypeName)
+enum TextureType {
+    TEXTURE_DIFFUSE,
+    TEXTURE_SPECULAR,
+    TEXTURE_NORMAL,
+    TEXTURE_HEIGHT,
+    TEXTURE_TYPE_COUNT
+};
 
+// GLSL sampler name prefix of a texture type, the Nth texture of a type is bound to <prefix>N
+inline const char *textureTypeName(TextureType type)
+{
+    static const char *names[TEXTURE_TYPE_COUNT] = {"texture_diffuse", "texture_specular", "texture_normal", "texture_height"};
+    return names[type];
+}
 
 struct Texture {
     unsigned int id;
-    string type;
+    TextureType type;
     string path;
 };
 
+// object space bounding volumes of a mesh, used for frustum culling
+struct Bounds {
+    glm::vec3 min;
+    glm::vec3 max;
+    // bounding sphere around the box center, tighter than the box's half diagonal
+    glm::vec3 center;
+    float radius;
+};
+
+inline Bounds computeBounds(const vector<Vertex> &vertices)
+{
+    Bounds bounds;
+    bounds.min = bounds.max = bounds.center = glm::vec3(0.0f);
+    bounds.radius = 0.0f;
+    if (vertices.empty())
+        return bounds;
+
+    bounds.min = bounds.max = vertices[0].Position;
+    for (const Vertex &vertex : vertices)
+    {
+        bounds.min = glm::min(bounds.min, vertex.Position);
+        bounds.max = glm::max(bounds.max, vertex.Position);
+    }
+    bounds.center = (bounds.min + bounds.max) * 0.5f;
+    for (const Vertex &vertex : vertices)
+        bounds.radius = glm::max(bounds.radius, glm::length(vertex.Position - bounds.center));
+    return bounds;
+}
+
+// a coarser version of a mesh: its own triangles over the same vertices (see MeshSimplifier)
+struct MeshLod {
+    vector<unsigned int> indices;
+    // object space distance the simplification moved the surface by, at most
+    float error;
+};
+
+// a node of a model's scene graph. A model keeps them flattened in one array, parents before their children.
+struct ModelNode {
+    // index of the parent node, -1 for the root
+    int parent;
+    // transform relative to the parent
+    glm::mat4 local;
+    string name;
+};
+
+// CPU side mesh data, as produced by the importer (or read back from the mesh cache) before any GL objects exist.
+// Texture ids are not resolved yet, only their type and path are set.
+struct MeshData {
+    vector<Vertex>       vertices;
+    vector<unsigned int> indices;
+    vector<Texture>      textures;
+    Bounds               bounds;
+    // levels of detail after the full mesh, coarsest last
+    vector<MeshLod>      lods;
+    // the model node the mesh hangs off, its vertices are relative to that node
+    unsigned int         node = 0;
+};
+
+// smallest index type that can address vertexCount vertices
+inline GLenum indexTypeFor(size_t vertexCount)
+{
+    if (vertexCount <= 0x100)
+        return GL_UNSIGNED_BYTE;
+    if (vertexCount <= 0x10000)
+        return GL_UNSIGNED_SHORT;
+    return GL_UNSIGNED_INT;
+}
+
+inline unsigned int indexTypeSize(GLenum type)
+{
+    return type == GL_UNSIGNED_BYTE ? 1 : type == GL_UNSIGNED_SHORT ? 2 : 4;
+}
+
 class Mesh {
 public:
     // mesh Data
     vector<Vertex>       vertices;
     vector<unsigned int> indices;
     vector<Texture>      textures;
+    Bounds               bounds;
+    // levels of detail after the full mesh (level 0), their indices follow the mesh's in the index buffer
+    vector<MeshLod>      lods;
+    // model node of the mesh (see Model::nodes)
+    unsigned int         node = 0;
+    // layout of the vertex buffer, vertices keeps the full Vertex data either way
+    VertexLayout         layout;
+    // type of the index buffer, the narrowest one the vertex count allows; indices keeps 32-bit values either way
+    GLenum               indexType;
 
+    // the VAO, shared with other meshes of the same layout when the mesh lives in the GeometryPool
     unsigned int VAO;
+    // where the mesh starts in the (possibly shared) vertex and index buffers
+    GLint baseVertex = 0;
+    size_t indexOffset = 0;
     std::string glslIdentifierPrefix;
     // constructor
     Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+        : Mesh(vertices, indices, textures, computeBounds(vertices))
+    {
+    }
+
+    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures, const Bounds &bounds,
+         const VertexLayout &layout = VertexLayout::full(), const vector<MeshLod> &lods = vector<MeshLod>())
     {
         this->vertices = vertices;
         this->indices = indices;
         this->textures = textures;
+        this->bounds = bounds;
+        this->lods = lods;
+        this->layout = layout;
+        this->indexType = indexTypeFor(vertices.size());
 
         // now that we have all the required data, set the vertex buffers and its attribute pointers.
         setupMesh();
@@ -56,82 +156,211 @@ public:
     // render the mesh
     void Draw(Shader &shader)
     {
-        // bind appropriate textures
-        unsigned int diffuseNr  = 1;
-        unsigned int specularNr = 1;
-        unsigned int normalNr   = 1;
-        unsigned int heightNr   = 1;
-        for(unsigned int i = 0; i < textures.size(); i++)
-        {
-            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
-            // retrieve texture number (the N in diffuse_textureN)
-            string number;
-            string name = textures[i].type;
-            if(name == "texture_diffuse")
-                number = std::to_string(diffuseNr++);
-            else if(name == "texture_specular")
-                number = std::to_string(specularNr++); // transfer unsigned int to stream
-            else if(name == "texture_normal")
-                number = std::to_string(normalNr++); // transfer unsigned int to stream
-            else if(name == "texture_height")
-                number = std::to_string(heightNr++); // transfer unsigned int to stream
+        bindTextures(shader);
 
-            // now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shader.ID, (glslIdentifierPrefix + name + number).c_str()), i);
-            // and finally bind the texture
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
-        }
+        // draw mesh
+        glBindVertexArray(VAO);
+        glDrawElementsBaseVertex(GL_TRIANGLES, indices.size(), indexType, (void*) indexOffset, baseVertex);
+        glBindVertexArray(0);
 
+        // always good practice to set everything back to defaults once configured.
+        glActiveTexture(GL_TEXTURE0);
+    }
 
+    // render instanceCount copies of the mesh, with per-instance model matrices taken from the instance buffer
+    // that was attached with setupInstanceAttributes
+    void DrawInstanced(Shader &shader, unsigned int instanceCount)
+    {
+        bindTextures(shader);
 
-        // draw mesh
         glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
+        drawElementsInstanced(instanceCount);
         glBindVertexArray(0);
 
-        // always good practice to set everything back to defaults once configured.
         glActiveTexture(GL_TEXTURE0);
     }
 
+    // just the draw call, VAO, textures and instance source have to be set up by the caller (see RenderQueue)
+    void drawElementsInstanced(unsigned int instanceCount, unsigned int lod = 0) const
+    {
+        glDrawElementsInstancedBaseVertex(GL_TRIANGLES, lodIndexCount(lod), indexType,
+                                          (void*)(indexOffset + lodFirstIndex(lod) * indexTypeSize(indexType)), instanceCount, baseVertex);
+    }
+
+    // first index in the index buffer, in indices (indexOffset is in bytes)
+    GLuint firstIndex() const
+    {
+        return indexOffset / indexTypeSize(indexType);
+    }
+
+    // levels of detail, including the full mesh
+    unsigned int lodCount() const
+    {
+        return 1 + lods.size();
+    }
+
+    // first index of a level of detail, relative to the mesh's first index
+    GLuint lodFirstIndex(unsigned int lod) const
+    {
+        GLuint first = lod > 0 ? indices.size() : 0;
+        for (unsigned int i = 1; i < lod; i++)
+            first += lods[i - 1].indices.size();
+        return first;
+    }
+
+    GLuint lodIndexCount(unsigned int lod) const
+    {
+        return lod == 0 ? indices.size() : lods[lod - 1].indices.size();
+    }
+
+    float lodError(unsigned int lod) const
+    {
+        return lod == 0 ? 0.0f : lods[lod - 1].error;
+    }
+
+    // feeds attribute locations 5-8 (one mat4, one column per location) from instanceVBO, advancing once per instance
+    void setupInstanceAttributes(unsigned int instanceVBO)
+    {
+        glBindVertexArray(VAO);
+        for (unsigned int column = 0; column < 4; column++)
+        {
+            glEnableVertexAttribArray(INSTANCE_MATRIX_LOCATION + column);
+            glVertexAttribDivisor(INSTANCE_MATRIX_LOCATION + column, 1);
+        }
+        vertexArray->instanceBuffer = 0;
+        vertexArray->setInstanceSource(instanceVBO, 0);
+        glBindVertexArray(0);
+    }
+
+    // points the instance matrix attributes at the matrices starting at offset bytes into buffer, see VertexArrayState.
+    // meshes sharing a VAO share the instance source too.
+    void setInstanceSource(unsigned int buffer, size_t offset)
+    {
+        vertexArray->setInstanceSource(buffer, offset);
+    }
+
+    // for indirect draws, which read draw ids instead of instance matrices, see VertexArrayState::setInstanceArrays
+    void disableInstanceSource()
+    {
+        vertexArray->setInstanceArrays(false);
+    }
+
+    // GPU memory of the vertex and index buffers
+    size_t vertexBufferBytes() const
+    {
+        return vertices.size() * layout.stride;
+    }
+
+    size_t indexBufferBytes() const
+    {
+        return (lodFirstIndex(lodCount() - 1) + lodIndexCount(lodCount() - 1)) * indexTypeSize(indexType);
+    }
+
+    void SetShaderTextureNamePrefix(const std::string &prefix)
+    {
+        glslIdentifierPrefix = prefix;
+        samplerBindings.clear();
+    }
+
+    // sampler locations for the textures of this mesh in the shader's program, worked out on the first draw with it
+    const vector<GLint> &samplerLocations(const Shader &shader)
+    {
+        for (const SamplerBinding &binding : samplerBindings)
+        {
+            if (binding.program == shader.ID)
+                return binding.locations;
+        }
+
+        // retrieve texture number (the N in diffuse_textureN)
+        SamplerBinding binding;
+        binding.program = shader.ID;
+        unsigned int numbers[TEXTURE_TYPE_COUNT] = {1, 1, 1, 1};
+        for (const Texture &texture : textures)
+        {
+            string name = glslIdentifierPrefix + textureTypeName(texture.type) + std::to_string(numbers[texture.type]++);
+            binding.locations.push_back(shader.location(name));
+        }
+        samplerBindings.push_back(binding);
+        return samplerBindings.back().locations;
+    }
+
 private:
     // render data
     unsigned int VBO, EBO;
+    shared_ptr<VertexArrayState> vertexArray;
+
+    // sampler uniform location of every texture, for one program
+    struct SamplerBinding {
+        unsigned int program;
+        vector<GLint> locations;
+    };
+    // one entry per program this mesh was drawn with, usually just one or two
+    vector<SamplerBinding> samplerBindings;
+
+    // binds every texture to its unit and points the sampler uniforms at them, texture i goes to unit i
+    void bindTextures(Shader &shader)
+    {
+        const vector<GLint> &locations = samplerLocations(shader);
+        for(unsigned int i = 0; i < textures.size(); i++)
+        {
+            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
+            // now set the sampler to the correct texture unit
+            glUniform1i(locations[i], i);
+            // and finally bind the texture
+            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+        }
+    }
 
-    // initializes all the buffer objects/arrays
+    // initializes all the buffer objects/arrays, in the GeometryPool when it's enabled
     void setupMesh()
     {
+        // vertex data converted to the mesh's layout
+        vector<unsigned char> vertexData;
+        layout.pack(vertices, vertexData);
+        // and the indices of every level of detail, narrowed to the index type
+        vector<unsigned int> allIndices(indices);
+        for (const MeshLod &lod : lods)
+            allIndices.insert(allIndices.end(), lod.indices.begin(), lod.indices.end());
+        vector<unsigned char> indexData(indexBufferBytes());
+        for (size_t i = 0; i < allIndices.size(); i++)
+        {
+            if (indexType == GL_UNSIGNED_BYTE)
+                indexData[i] = (unsigned char) allIndices[i];
+            else if (indexType == GL_UNSIGNED_SHORT)
+                ((unsigned short *) indexData.data())[i] = (unsigned short) allIndices[i];
+            else
+                ((unsigned int *) indexData.data())[i] = allIndices[i];
+        }
+
+        if (GeometryPool::enabled)
+        {
+            GeometryAllocation allocation = GeometryPool::instance().allocate(layout, vertexData, indexData);
+            vertexArray = allocation.vertexArray;
+            VAO = vertexArray->vao;
+            VBO = allocation.vertexBuffer;
+            EBO = allocation.indexBuffer;
+            baseVertex = allocation.baseVertex;
+            indexOffset = allocation.indexOffset;
+            return;
+        }
+
         // create buffers/arrays
-        glGenVertexArrays(1, &VAO);
+        vertexArray = make_shared<VertexArrayState>();
+        glGenVertexArrays(1, &vertexArray->vao);
+        VAO = vertexArray->vao;
         glGenBuffers(1, &VBO);
         glGenBuffers(1, &EBO);
 
         glBindVertexArray(VAO);
         // load data into vertex buffers
         glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        // A great thing about structs is that their memory layout is sequential for all its items.
-        // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
-        // again translates to 3/2 floats which translates to a byte array.
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
+        glBufferData(GL_ARRAY_BUFFER, vertexData.size(), vertexData.data(), GL_STATIC_DRAW);
 
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexData.size(), indexData.data(), GL_STATIC_DRAW);
 
         // set the vertex attribute pointers
-        // vertex Positions
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-        // vertex normals
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-        // vertex texture coords
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
-        // vertex tangent
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
-        // vertex bitangent
-        glEnableVertexAttribArray(4);
-        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
+        layout.setAttributePointers();
 
         glBindVertexArray(0);
     }
@@ -0,0 +1,331 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <learnopengl/mesh.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <iostream>
+using namespace std;
+
+// On-disk cache of the already post-processed Assimp output of a model file, so warm starts don't have to run the importer.
+// One cache file per source file, named after a hash of its path. Layout (native endianness and struct layout):
+//   MeshCacheHeader, source path bytes
+//   for every mesh: MeshCacheMeshHeader, Bounds, Vertex[vertexCount], unsigned int[indexCount],
+//                   textureCount x (uint32 TextureType, uint32 path length, path bytes),
+//                   lodCount x (uint32 index count, float error, unsigned int[index count])
+//   uint32 node count, for every node: int32 parent, float[16] local matrix, uint32 name length, name bytes
+// A cache file is only used when magic, version, import flags, vertex size and the source file's mtime and size all match.
+struct MeshCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t importFlags;
+    uint32_t vertexSize;
+    int64_t  sourceMtimeSec;
+    int64_t  sourceMtimeNsec;
+    int64_t  sourceSize;
+    uint32_t pathLength;
+    uint32_t meshCount;
+};
+
+struct MeshCacheMeshHeader {
+    uint32_t vertexCount;
+    uint32_t indexCount;
+    uint32_t textureCount;
+    uint32_t lodCount;
+    uint32_t node;
+};
+
+class MeshCache
+{
+public:
+    static const uint32_t MAGIC   = 0x4853454d; // "MESH"
+    static const uint32_t VERSION = 7;
+
+    // set to false to always go through Assimp (e.g. to measure cold start times)
+    static bool enabled;
+    static string directory;
+
+    // returns the cache file used for the given model file
+    static string cachePathFor(const string &sourcePath)
+    {
+        // 64-bit FNV-1a of the source path
+        uint64_t hash = 14695981039346656037ull;
+        for (unsigned char c : sourcePath) {
+            hash ^= c;
+            hash *= 1099511628211ull;
+        }
+        char name[32];
+        snprintf(name, sizeof(name), "%016llx.meshcache", (unsigned long long) hash);
+        return directory + '/' + name;
+    }
+
+    // fills meshes and nodes from the cache file of sourcePath, returns false if there is no usable (up to date) cache file
+    static bool load(const string &sourcePath, unsigned int importFlags, vector<MeshData> &meshes, vector<ModelNode> &nodes)
+    {
+        if (!enabled)
+            return false;
+
+        struct stat source;
+        if (stat(sourcePath.c_str(), &source) != 0)
+            return false;
+
+        int fd = open(cachePathFor(sourcePath).c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat cache;
+        if (fstat(fd, &cache) != 0 || cache.st_size < (off_t) sizeof(MeshCacheHeader)) {
+            close(fd);
+            return false;
+        }
+        size_t size = cache.st_size;
+        void *mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (mapped == MAP_FAILED)
+            return false;
+
+        bool ok = parse((const char *) mapped, size, sourcePath, importFlags, source, meshes, nodes);
+        munmap(mapped, size);
+        if (!ok) {
+            meshes.clear();
+            nodes.clear();
+        }
+        return ok;
+    }
+
+    // writes meshes and nodes to the cache file of sourcePath; the file is written under a temporary name and renamed into place
+    static bool store(const string &sourcePath, unsigned int importFlags, const vector<MeshData> &meshes,
+                      const vector<ModelNode> &nodes)
+    {
+        if (!enabled)
+            return false;
+
+        struct stat source;
+        if (stat(sourcePath.c_str(), &source) != 0)
+            return false;
+        mkdir(directory.c_str(), 0755);
+
+        string cachePath = cachePathFor(sourcePath);
+        string tmpPath = cachePath + ".tmp" + to_string(getpid());
+        FILE *out = fopen(tmpPath.c_str(), "wb");
+        if (!out) {
+            cout << "ERROR::MESH_CACHE:: can't write " << tmpPath << endl;
+            return false;
+        }
+
+        MeshCacheHeader header;
+        header.magic = MAGIC;
+        header.version = VERSION;
+        header.importFlags = importFlags;
+        header.vertexSize = sizeof(Vertex);
+        header.sourceMtimeSec = source.st_mtim.tv_sec;
+        header.sourceMtimeNsec = source.st_mtim.tv_nsec;
+        header.sourceSize = source.st_size;
+        header.pathLength = sourcePath.size();
+        header.meshCount = meshes.size();
+        bool ok = fwrite(&header, sizeof(header), 1, out) == 1;
+        ok = ok && writeBytes(out, sourcePath.data(), sourcePath.size());
+
+        for (const MeshData &mesh : meshes) {
+            MeshCacheMeshHeader meshHeader;
+            meshHeader.vertexCount = mesh.vertices.size();
+            meshHeader.indexCount = mesh.indices.size();
+            meshHeader.textureCount = mesh.textures.size();
+            meshHeader.lodCount = mesh.lods.size();
+            meshHeader.node = mesh.node;
+            ok = ok && fwrite(&meshHeader, sizeof(meshHeader), 1, out) == 1;
+            ok = ok && fwrite(&mesh.bounds, sizeof(Bounds), 1, out) == 1;
+            ok = ok && writeBytes(out, mesh.vertices.data(), mesh.vertices.size() * sizeof(Vertex));
+            ok = ok && writeBytes(out, mesh.indices.data(), mesh.indices.size() * sizeof(unsigned int));
+            for (const Texture &texture : mesh.textures) {
+                uint32_t type = texture.type;
+                ok = ok && fwrite(&type, sizeof(type), 1, out) == 1;
+                ok = ok && writeString(out, texture.path);
+            }
+            for (const MeshLod &lod : mesh.lods) {
+                uint32_t indexCount = lod.indices.size();
+                ok = ok && fwrite(&indexCount, sizeof(indexCount), 1, out) == 1;
+                ok = ok && fwrite(&lod.error, sizeof(float), 1, out) == 1;
+                ok = ok && writeBytes(out, lod.indices.data(), lod.indices.size() * sizeof(unsigned int));
+            }
+        }
+        uint32_t nodeCount = nodes.size();
+        ok = ok && fwrite(&nodeCount, sizeof(nodeCount), 1, out) == 1;
+        for (const ModelNode &node : nodes) {
+            int32_t parent = node.parent;
+            ok = ok && fwrite(&parent, sizeof(parent), 1, out) == 1;
+            ok = ok && fwrite(&node.local, sizeof(glm::mat4), 1, out) == 1;
+            ok = ok && writeString(out, node.name);
+        }
+
+        ok = (fclose(out) == 0) && ok;
+        if (!ok || rename(tmpPath.c_str(), cachePath.c_str()) != 0) {
+            cout << "ERROR::MESH_CACHE:: failed writing " << cachePath << endl;
+            remove(tmpPath.c_str());
+            return false;
+        }
+        return true;
+    }
+
+private:
+    // bounds checked reader over the mapped cache file
+    struct Reader {
+        const char *data;
+        size_t size;
+        size_t offset;
+
+        bool read(void *dst, size_t bytes)
+        {
+            if (bytes > size - offset)
+                return false;
+            memcpy(dst, data + offset, bytes);
+            offset += bytes;
+            return true;
+        }
+
+        const char *take(size_t bytes)
+        {
+            if (bytes > size - offset)
+                return nullptr;
+            const char *p = data + offset;
+            offset += bytes;
+            return p;
+        }
+
+        // whether count items of at least itemBytes each can still be in the file, checked before sizing
+        // anything by a count read from it
+        bool fits(size_t count, size_t itemBytes) const
+        {
+            return count <= (size - offset) / itemBytes;
+        }
+
+        bool readString(string &str)
+        {
+            uint32_t length;
+            if (!read(&length, sizeof(length)))
+                return false;
+            const char *p = take(length);
+            if (!p)
+                return false;
+            str.assign(p, length);
+            return true;
+        }
+    };
+
+    static bool parse(const char *data, size_t size, const string &sourcePath, unsigned int importFlags,
+                      const struct stat &source, vector<MeshData> &meshes, vector<ModelNode> &nodes)
+    {
+        Reader reader = {data, size, 0};
+        MeshCacheHeader header;
+        if (!reader.read(&header, sizeof(header)))
+            return false;
+        if (header.magic != MAGIC || header.version != VERSION || header.importFlags != importFlags
+            || header.vertexSize != sizeof(Vertex)
+            || header.sourceMtimeSec != (int64_t) source.st_mtim.tv_sec
+            || header.sourceMtimeNsec != (int64_t) source.st_mtim.tv_nsec
+            || header.sourceSize != (int64_t) source.st_size)
+            return false;
+        // guards against hash collisions between two source paths
+        const char *path = reader.take(header.pathLength);
+        if (!path || sourcePath.compare(0, string::npos, path, header.pathLength) != 0)
+            return false;
+
+        if (!reader.fits(header.meshCount, sizeof(MeshCacheMeshHeader) + sizeof(Bounds)))
+            return false;
+        meshes.resize(header.meshCount);
+        for (MeshData &mesh : meshes) {
+            MeshCacheMeshHeader meshHeader;
+            if (!reader.read(&meshHeader, sizeof(meshHeader)) || !reader.read(&mesh.bounds, sizeof(Bounds)))
+                return false;
+            const char *vertices = reader.take((size_t) meshHeader.vertexCount * sizeof(Vertex));
+            const char *indices = reader.take((size_t) meshHeader.indexCount * sizeof(unsigned int));
+            if (!vertices || !indices)
+                return false;
+            mesh.vertices.resize(meshHeader.vertexCount);
+            memcpy(mesh.vertices.data(), vertices, (size_t) meshHeader.vertexCount * sizeof(Vertex));
+            mesh.indices.resize(meshHeader.indexCount);
+            memcpy(mesh.indices.data(), indices, (size_t) meshHeader.indexCount * sizeof(unsigned int));
+            if (!indicesInRange(mesh.indices, meshHeader.vertexCount))
+                return false;
+            // a texture is at least its type and path length, a level of detail its index count and error
+            if (!reader.fits(meshHeader.textureCount, 2 * sizeof(uint32_t)))
+                return false;
+            mesh.textures.resize(meshHeader.textureCount);
+            for (Texture &texture : mesh.textures) {
+                texture.id = 0;
+                uint32_t type;
+                if (!reader.read(&type, sizeof(type)) || type >= TEXTURE_TYPE_COUNT || !reader.readString(texture.path))
+                    return false;
+                texture.type = (TextureType) type;
+            }
+            if (!reader.fits(meshHeader.lodCount, sizeof(uint32_t) + sizeof(float)))
+                return false;
+            mesh.lods.resize(meshHeader.lodCount);
+            for (MeshLod &lod : mesh.lods) {
+                uint32_t indexCount;
+                if (!reader.read(&indexCount, sizeof(indexCount)) || !reader.read(&lod.error, sizeof(float)))
+                    return false;
+                const char *lodIndices = reader.take((size_t) indexCount * sizeof(unsigned int));
+                if (!lodIndices)
+                    return false;
+                lod.indices.resize(indexCount);
+                memcpy(lod.indices.data(), lodIndices, (size_t) indexCount * sizeof(unsigned int));
+                if (!indicesInRange(lod.indices, meshHeader.vertexCount))
+                    return false;
+            }
+            mesh.node = meshHeader.node;
+        }
+        uint32_t nodeCount;
+        if (!reader.read(&nodeCount, sizeof(nodeCount)))
+            return false;
+        if (!reader.fits(nodeCount, sizeof(int32_t) + sizeof(glm::mat4) + sizeof(uint32_t)))
+            return false;
+        nodes.resize(nodeCount);
+        for (unsigned int i = 0; i < nodeCount; i++) {
+            int32_t parent;
+            if (!reader.read(&parent, sizeof(parent)) || !reader.read(&nodes[i].local, sizeof(glm::mat4))
+                || !reader.readString(nodes[i].name))
+                return false;
+            // parents come first, anything else is a corrupt file
+            if (parent >= (int32_t) i)
+                return false;
+            nodes[i].parent = parent;
+        }
+        for (const MeshData &mesh : meshes)
+            if (mesh.node >= nodeCount)
+                return false;
+        return reader.offset == size;
+    }
+
+    static bool indicesInRange(const vector<unsigned int> &indices, uint32_t vertexCount)
+    {
+        for (unsigned int index : indices)
+            if (index >= vertexCount)
+                return false;
+        return true;
+    }
+
+    static bool writeBytes(FILE *out, const void *data, size_t bytes)
+    {
+        return bytes == 0 || fwrite(data, bytes, 1, out) == 1;
+    }
+
+    static bool writeString(FILE *out, const string &str)
+    {
+        uint32_t length = str.size();
+        return fwrite(&length, sizeof(length), 1, out) == 1 && writeBytes(out, str.data(), str.size());
+    }
+};
+
+bool MeshCache::enabled = true;
+string MeshCache::directory = "resources/cache";
+#endif
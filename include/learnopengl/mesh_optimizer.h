@@ -0,0 +1,382 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/mesh.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+// Import time optimization of indexed triangle meshes, the result is what ends up in the mesh cache:
+//   1. vertex deduplication (the importer emits a vertex per face corner)
+//   2. post-transform vertex cache ordering (Forsyth, "Linear-Speed Vertex Cache Optimisation")
+//   3. overdraw ordering: the cache ordered triangles are cut into clusters where the cache runs cold and the
+//      clusters are sorted outside-in (Sander et al., "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw")
+//   4. vertex fetch ordering: vertices are renumbered in the order the index buffer first uses them
+class MeshOptimizer
+{
+public:
+    // FIFO size used to measure ACMR/ATVR, a conservative post-transform cache size
+    static const unsigned int ANALYSIS_CACHE_SIZE = 16;
+
+    struct Report {
+        size_t triangles = 0;
+        size_t verticesBefore = 0;
+        size_t verticesAfter = 0;
+        // average cache miss ratio (transformed vertices per triangle, 0.5 is ideal)
+        float acmrBefore = 0.0f;
+        float acmrAfter = 0.0f;
+        // average transform to vertex ratio (1.0 is ideal)
+        float atvrBefore = 0.0f;
+        float atvrAfter = 0.0f;
+    };
+
+    static Report optimize(MeshData &mesh)
+    {
+        Report report;
+        report.triangles = mesh.indices.size() / 3;
+        report.verticesBefore = mesh.vertices.size();
+        size_t missesBefore = cacheMisses(mesh.indices, mesh.vertices.size(), ANALYSIS_CACHE_SIZE);
+
+        if (mesh.indices.size() % 3 == 0 && !mesh.indices.empty()) {
+            deduplicateVertices(mesh);
+            optimizeVertexCache(mesh.indices, mesh.vertices.size());
+            optimizeOverdraw(mesh.indices, mesh.vertices);
+            optimizeVertexFetch(mesh);
+        }
+
+        report.verticesAfter = mesh.vertices.size();
+        size_t missesAfter = cacheMisses(mesh.indices, mesh.vertices.size(), ANALYSIS_CACHE_SIZE);
+        if (report.triangles > 0) {
+            report.acmrBefore = (float) missesBefore / report.triangles;
+            report.acmrAfter = (float) missesAfter / report.triangles;
+        }
+        if (report.verticesBefore > 0)
+            report.atvrBefore = (float) missesBefore / report.verticesBefore;
+        if (report.verticesAfter > 0)
+            report.atvrAfter = (float) missesAfter / report.verticesAfter;
+        return report;
+    }
+
+    // vertex shader invocations of the index buffer on a FIFO post-transform cache of cacheSize entries
+    static size_t cacheMisses(const vector<unsigned int> &indices, size_t vertexCount, unsigned int cacheSize)
+    {
+        // a vertex is in the cache while fewer than cacheSize misses happened since it was loaded
+        vector<size_t> loadedAt(vertexCount, 0);
+        size_t misses = 0;
+        for (unsigned int index : indices) {
+            if (index >= vertexCount)
+                continue;
+            if (loadedAt[index] == 0 || misses + 1 - loadedAt[index] >= cacheSize) {
+                misses++;
+                loadedAt[index] = misses;
+            }
+        }
+        return misses;
+    }
+
+    // Splits a mesh with more vertices than 16-bit indices can address into chunks that each fit, cutting the
+    // triangle list in order (after optimize() consecutive triangles share vertices, so few get duplicated).
+    // Only splits when the index memory saved outweighs the duplicated vertices, returns false otherwise.
+    static bool splitForShortIndices(const MeshData &mesh, vector<MeshData> &chunks)
+    {
+        const size_t maxVertices = 0x10000;
+        if (mesh.vertices.size() <= maxVertices || mesh.indices.size() % 3 != 0)
+            return false;
+
+        vector<MeshData> split;
+        const unsigned int unused = ~0u;
+        vector<unsigned int> remap(mesh.vertices.size(), unused);
+        size_t chunkStart = 0;
+        for (size_t t = 0; t <= mesh.indices.size() / 3; t++) {
+            bool last = t == mesh.indices.size() / 3;
+            if (!split.empty() && !last) {
+                unsigned int newVertices = 0;
+                for (int k = 0; k < 3; k++)
+                    newVertices += remap[mesh.indices[t * 3 + k]] == unused;
+                if (split.back().vertices.size() + newVertices <= maxVertices) {
+                    addTriangle(mesh, t, remap, split.back());
+                    continue;
+                }
+            }
+            // chunk full (or first triangle): forget the old chunk's vertices and start a new one
+            if (!split.empty())
+                for (size_t i = chunkStart * 3; i < t * 3; i++)
+                    remap[mesh.indices[i]] = unused;
+            if (last)
+                break;
+            chunkStart = t;
+            split.push_back(MeshData());
+            split.back().textures = mesh.textures;
+            split.back().node = mesh.node;
+            addTriangle(mesh, t, remap, split.back());
+        }
+
+        size_t splitVertices = 0;
+        for (const MeshData &chunk : split)
+            splitVertices += chunk.vertices.size();
+        size_t savedIndexBytes = mesh.indices.size() * (sizeof(unsigned int) - sizeof(unsigned short));
+        size_t addedVertexBytes = (splitVertices - mesh.vertices.size()) * sizeof(Vertex);
+        if (split.size() < 2 || addedVertexBytes >= savedIndexBytes)
+            return false;
+
+        for (MeshData &chunk : split)
+            chunk.bounds = computeBounds(chunk.vertices);
+        chunks.swap(split);
+        return true;
+    }
+
+private:
+    static const int FORSYTH_CACHE_SIZE = 32;
+
+    static void addTriangle(const MeshData &mesh, size_t triangle, vector<unsigned int> &remap, MeshData &chunk)
+    {
+        for (int k = 0; k < 3; k++) {
+            unsigned int index = mesh.indices[triangle * 3 + k];
+            if (remap[index] == ~0u) {
+                remap[index] = chunk.vertices.size();
+                chunk.vertices.push_back(mesh.vertices[index]);
+            }
+            chunk.indices.push_back(remap[index]);
+        }
+    }
+
+    struct VertexHash {
+        size_t operator()(const Vertex &vertex) const
+        {
+            // FNV-1a over the raw bytes, Vertex has no padding
+            const unsigned char *bytes = (const unsigned char *) &vertex;
+            size_t hash = 14695981039346656037ull;
+            for (size_t i = 0; i < sizeof(Vertex); i++) {
+                hash ^= bytes[i];
+                hash *= 1099511628211ull;
+            }
+            return hash;
+        }
+    };
+
+    struct VertexEqual {
+        bool operator()(const Vertex &a, const Vertex &b) const
+        {
+            return memcmp(&a, &b, sizeof(Vertex)) == 0;
+        }
+    };
+
+    static void deduplicateVertices(MeshData &mesh)
+    {
+        unordered_map<Vertex, unsigned int, VertexHash, VertexEqual> unique;
+        unique.reserve(mesh.vertices.size());
+        vector<unsigned int> remap(mesh.vertices.size());
+        vector<Vertex> vertices;
+        for (size_t i = 0; i < mesh.vertices.size(); i++) {
+            auto inserted = unique.emplace(mesh.vertices[i], (unsigned int) vertices.size());
+            if (inserted.second)
+                vertices.push_back(mesh.vertices[i]);
+            remap[i] = inserted.first->second;
+        }
+        for (unsigned int &index : mesh.indices)
+            index = remap[index];
+        mesh.vertices.swap(vertices);
+    }
+
+    static float forsythVertexScore(int cachePosition, unsigned int remainingTriangles)
+    {
+        if (remainingTriangles == 0)
+            return -1.0f;
+        float score = 0.0f;
+        if (cachePosition >= 0) {
+            if (cachePosition < 3)
+                score = 0.75f; // used by the last triangle, fixed score so no triangle is strongly preferred
+            else
+                score = pow(1.0f - (cachePosition - 3) * (1.0f / (FORSYTH_CACHE_SIZE - 3)), 1.5f);
+        }
+        // boost vertices with few triangles left, so they get finished instead of leaving lone triangles behind
+        return score + 2.0f * pow((float) remainingTriangles, -0.5f);
+    }
+
+public:
+    // reorders the triangles for the post-transform vertex cache (Forsyth)
+    static void optimizeVertexCache(vector<unsigned int> &indices, size_t vertexCount)
+    {
+        size_t triangleCount = indices.size() / 3;
+
+        // triangles of every vertex, the first remaining[v] entries of its range are the ones not emitted yet
+        vector<unsigned int> remaining(vertexCount, 0);
+        for (unsigned int index : indices)
+            remaining[index]++;
+        vector<unsigned int> offsets(vertexCount + 1, 0);
+        for (size_t v = 0; v < vertexCount; v++)
+            offsets[v + 1] = offsets[v] + remaining[v];
+        vector<unsigned int> adjacency(indices.size());
+        vector<unsigned int> filled(vertexCount, 0);
+        for (size_t t = 0; t < triangleCount; t++)
+            for (int k = 0; k < 3; k++) {
+                unsigned int v = indices[t * 3 + k];
+                adjacency[offsets[v] + filled[v]++] = t;
+            }
+
+        vector<int> cachePosition(vertexCount, -1);
+        vector<float> vertexScore(vertexCount);
+        for (size_t v = 0; v < vertexCount; v++)
+            vertexScore[v] = forsythVertexScore(-1, remaining[v]);
+        vector<float> triangleScore(triangleCount);
+        for (size_t t = 0; t < triangleCount; t++)
+            triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+        vector<bool> emitted(triangleCount, false);
+
+        vector<unsigned int> output;
+        output.reserve(indices.size());
+        vector<unsigned int> cache, newCache;
+        size_t nextUnemitted = 0;
+
+        int best = 0;
+        for (size_t t = 1; t < triangleCount; t++)
+            if (triangleScore[t] > triangleScore[best])
+                best = t;
+
+        while (best >= 0) {
+            emitted[best] = true;
+            unsigned int triangle[3] = {indices[best * 3], indices[best * 3 + 1], indices[best * 3 + 2]};
+            newCache.clear();
+            for (unsigned int v : triangle) {
+                output.push_back(v);
+                // drop the triangle from the vertex's remaining ones
+                unsigned int *begin = &adjacency[offsets[v]];
+                unsigned int *end = begin + remaining[v];
+                unsigned int *found = find(begin, end, (unsigned int) best);
+                if (found != end) {
+                    swap(*found, *(end - 1));
+                    remaining[v]--;
+                }
+                if (find(newCache.begin(), newCache.end(), v) == newCache.end())
+                    newCache.push_back(v);
+            }
+            for (unsigned int v : cache)
+                if (find(newCache.begin(), newCache.end(), v) == newCache.end())
+                    newCache.push_back(v);
+
+            // vertices pushed out of the cache lose their position score
+            for (size_t i = FORSYTH_CACHE_SIZE; i < newCache.size(); i++) {
+                cachePosition[newCache[i]] = -1;
+                vertexScore[newCache[i]] = forsythVertexScore(-1, remaining[newCache[i]]);
+            }
+            if (newCache.size() > (size_t) FORSYTH_CACHE_SIZE)
+                newCache.resize(FORSYTH_CACHE_SIZE);
+            for (size_t i = 0; i < newCache.size(); i++) {
+                cachePosition[newCache[i]] = i;
+                vertexScore[newCache[i]] = forsythVertexScore(i, remaining[newCache[i]]);
+            }
+            cache.swap(newCache);
+
+            // only triangles of cached vertices changed score, the best of them is next
+            best = -1;
+            float bestScore = -1.0f;
+            for (unsigned int v : cache) {
+                for (unsigned int i = 0; i < remaining[v]; i++) {
+                    unsigned int t = adjacency[offsets[v] + i];
+                    triangleScore[t] = vertexScore[indices[t * 3]] + vertexScore[indices[t * 3 + 1]] + vertexScore[indices[t * 3 + 2]];
+                    if (triangleScore[t] > bestScore) {
+                        bestScore = triangleScore[t];
+                        best = t;
+                    }
+                }
+            }
+            // nothing adjacent to the cache is left, continue with the next triangle in file order
+            if (best < 0) {
+                while (nextUnemitted < triangleCount && emitted[nextUnemitted])
+                    nextUnemitted++;
+                if (nextUnemitted < triangleCount)
+                    best = nextUnemitted;
+            }
+        }
+        indices.swap(output);
+    }
+
+private:
+    static void optimizeOverdraw(vector<unsigned int> &indices, const vector<Vertex> &vertices)
+    {
+        size_t triangleCount = indices.size() / 3;
+
+        // cluster boundaries where all three vertices of a triangle miss the cache, reordering whole clusters
+        // then costs (almost) no vertex cache efficiency
+        vector<size_t> clusterStarts;
+        vector<size_t> loadedAt(vertices.size(), 0);
+        size_t misses = 0;
+        for (size_t t = 0; t < triangleCount; t++) {
+            int triangleMisses = 0;
+            for (int k = 0; k < 3; k++) {
+                unsigned int v = indices[t * 3 + k];
+                if (loadedAt[v] == 0 || misses + 1 - loadedAt[v] >= ANALYSIS_CACHE_SIZE) {
+                    misses++;
+                    loadedAt[v] = misses;
+                    triangleMisses++;
+                }
+            }
+            if (t == 0 || triangleMisses == 3)
+                clusterStarts.push_back(t);
+        }
+        if (clusterStarts.size() < 2)
+            return;
+        clusterStarts.push_back(triangleCount);
+
+        glm::vec3 meshCenter(0.0f);
+        for (const Vertex &vertex : vertices)
+            meshCenter += vertex.Position;
+        meshCenter /= (float) vertices.size();
+
+        // clusters facing away from the mesh center are likely occluders, those are drawn first
+        vector<pair<float, size_t>> clusters;
+        for (size_t c = 0; c + 1 < clusterStarts.size(); c++) {
+            glm::vec3 centroid(0.0f), normal(0.0f);
+            float area = 0.0f;
+            for (size_t t = clusterStarts[c]; t < clusterStarts[c + 1]; t++) {
+                const glm::vec3 &a = vertices[indices[t * 3]].Position;
+                const glm::vec3 &b = vertices[indices[t * 3 + 1]].Position;
+                const glm::vec3 &d = vertices[indices[t * 3 + 2]].Position;
+                glm::vec3 faceNormal = glm::cross(b - a, d - a);
+                float faceArea = glm::length(faceNormal);
+                centroid += (a + b + d) * (faceArea / 3.0f);
+                normal += faceNormal;
+                area += faceArea;
+            }
+            float normalLength = glm::length(normal);
+            float key = 0.0f;
+            if (area > 0.0f && normalLength > 0.0f)
+                key = glm::dot(centroid / area - meshCenter, normal / normalLength);
+            clusters.push_back({-key, c});
+        }
+        stable_sort(clusters.begin(), clusters.end(), [](const pair<float, size_t> &a, const pair<float, size_t> &b) {
+            return a.first < b.first;
+        });
+
+        vector<unsigned int> output;
+        output.reserve(indices.size());
+        for (const pair<float, size_t> &cluster : clusters)
+            output.insert(output.end(), indices.begin() + clusterStarts[cluster.second] * 3,
+                          indices.begin() + clusterStarts[cluster.second + 1] * 3);
+        indices.swap(output);
+    }
+
+    static void optimizeVertexFetch(MeshData &mesh)
+    {
+        const unsigned int unused = ~0u;
+        vector<unsigned int> remap(mesh.vertices.size(), unused);
+        vector<Vertex> vertices;
+        vertices.reserve(mesh.vertices.size());
+        for (unsigned int &index : mesh.indices) {
+            if (remap[index] == unused) {
+                remap[index] = vertices.size();
+                vertices.push_back(mesh.vertices[index]);
+            }
+            index = remap[index];
+        }
+        // vertices no triangle uses are dropped
+        mesh.vertices.swap(vertices);
+    }
+};
+#endif
@@ -0,0 +1,248 @@
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/mesh.h>
+#include <learnopengl/mesh_optimizer.h>
+
+#include <algorithm>
+#include <cmath>
+#include <queue>
+#include <vector>
+using namespace std;
+
+// Quadric error metric edge collapse simplification (Garland & Heckbert, "Surface Simplification Using Quadric
+// Error Metrics"). Vertices collapse onto one of their neighbours instead of an optimal new position, so a level
+// of detail is just another index buffer over the mesh's vertices. Vertices on open edges are never removed, which
+// also keeps texture and normal seams (the importer splits vertices there) closed.
+class MeshSimplifier
+{
+public:
+    // fractions of the full triangle count the levels of detail aim for
+    static const vector<float> &lodRatios()
+    {
+        static const vector<float> ratios = {0.5f, 0.25f, 0.125f};
+        return ratios;
+    }
+    // meshes with fewer triangles get no levels of detail
+    static const size_t MIN_LOD_TRIANGLES = 512;
+
+    // fills mesh.lods with progressively coarser index buffers, stops at the first ratio the simplifier can't get
+    // meaningfully closer to (e.g. everything left is locked)
+    static void generateLods(MeshData &mesh)
+    {
+        mesh.lods.clear();
+        size_t triangles = mesh.indices.size() / 3;
+        if (triangles < MIN_LOD_TRIANGLES || mesh.indices.size() % 3 != 0)
+            return;
+
+        const vector<unsigned int> *source = &mesh.indices;
+        float error = 0.0f;
+        for (float ratio : lodRatios()) {
+            size_t target = (size_t) (triangles * ratio) * 3;
+            MeshLod lod;
+            // each level continues from the last, so errors only add up
+            lod.indices = simplify(mesh.vertices, *source, target, lod.error);
+            lod.error += error;
+            if (lod.indices.empty() || lod.indices.size() > source->size() * 9 / 10)
+                break;
+            MeshOptimizer::optimizeVertexCache(lod.indices, mesh.vertices.size());
+            error = lod.error;
+            mesh.lods.push_back(std::move(lod));
+            source = &mesh.lods.back().indices;
+        }
+    }
+
+    // collapses edges of the triangle list until it has at most targetIndexCount indices (or nothing can collapse),
+    // error is the largest distance a collapse moved the surface by
+    static vector<unsigned int> simplify(const vector<Vertex> &vertices, const vector<unsigned int> &indices,
+                                         size_t targetIndexCount, float &error)
+    {
+        size_t vertexCount = vertices.size();
+        size_t triangleCount = indices.size() / 3;
+        vector<unsigned int> triangles(indices);
+
+        // the fundamental error quadric of every vertex: its faces' planes
+        vector<Quadric> quadrics(vertexCount);
+        vector<vector<unsigned int>> vertexTriangles(vertexCount);
+        for (size_t t = 0; t < triangleCount; t++) {
+            glm::vec3 a = vertices[triangles[t * 3]].Position;
+            glm::vec3 normal = glm::cross(vertices[triangles[t * 3 + 1]].Position - a, vertices[triangles[t * 3 + 2]].Position - a);
+            float length = glm::length(normal);
+            Quadric plane;
+            if (length > 0.0f) {
+                normal /= length;
+                plane = Quadric(normal, -glm::dot(normal, a));
+            }
+            for (int k = 0; k < 3; k++) {
+                quadrics[triangles[t * 3 + k]] += plane;
+                vertexTriangles[triangles[t * 3 + k]].push_back(t);
+            }
+        }
+
+        // an edge used by only one triangle is open, its vertices stay
+        vector<bool> locked(vertexCount, false);
+        {
+            vector<pair<unsigned int, unsigned int>> edges;
+            edges.reserve(indices.size());
+            for (size_t t = 0; t < triangleCount; t++)
+                for (int k = 0; k < 3; k++) {
+                    unsigned int a = triangles[t * 3 + k], b = triangles[t * 3 + (k + 1) % 3];
+                    edges.push_back({min(a, b), max(a, b)});
+                }
+            sort(edges.begin(), edges.end());
+            for (size_t i = 0; i < edges.size();) {
+                size_t j = i;
+                while (j < edges.size() && edges[j] == edges[i])
+                    j++;
+                if (j - i == 1)
+                    locked[edges[i].first] = locked[edges[i].second] = true;
+                i = j;
+            }
+        }
+
+        vector<bool> removedTriangle(triangleCount, false);
+        vector<unsigned int> version(vertexCount, 0);
+        priority_queue<Collapse, vector<Collapse>, greater<Collapse>> heap;
+        for (size_t t = 0; t < triangleCount; t++)
+            for (int k = 0; k < 3; k++)
+                pushCollapse(heap, vertices, quadrics, locked, version, triangles[t * 3 + k], triangles[t * 3 + (k + 1) % 3]);
+
+        error = 0.0f;
+        size_t liveTriangles = triangleCount;
+        vector<unsigned int> neighbours;
+        while (liveTriangles * 3 > targetIndexCount && !heap.empty()) {
+            Collapse collapse = heap.top();
+            heap.pop();
+            unsigned int from = collapse.from, to = collapse.to;
+            // an end was merged since this was queued, edges around the merged vertex are requeued with the new cost
+            if (collapse.fromVersion != version[from] || collapse.toVersion != version[to])
+                continue;
+            if (flipsTriangle(vertices, triangles, vertexTriangles[from], removedTriangle, from, to))
+                continue;
+
+            error = max(error, (float) sqrt(max(collapse.cost, 0.0)));
+            quadrics[to] += quadrics[from];
+            version[from]++;
+            version[to]++;
+            for (unsigned int t : vertexTriangles[from]) {
+                if (removedTriangle[t])
+                    continue;
+                unsigned int *triangle = &triangles[t * 3];
+                for (int k = 0; k < 3; k++)
+                    if (triangle[k] == from)
+                        triangle[k] = to;
+                if (triangle[0] == triangle[1] || triangle[1] == triangle[2] || triangle[0] == triangle[2]) {
+                    removedTriangle[t] = true;
+                    liveTriangles--;
+                } else {
+                    vertexTriangles[to].push_back(t);
+                }
+            }
+            vertexTriangles[from].clear();
+
+            // requeue every edge around the merged vertex with its new quadric
+            neighbours.clear();
+            for (unsigned int t : vertexTriangles[to])
+                if (!removedTriangle[t])
+                    for (int k = 0; k < 3; k++)
+                        if (triangles[t * 3 + k] != to)
+                            neighbours.push_back(triangles[t * 3 + k]);
+            sort(neighbours.begin(), neighbours.end());
+            neighbours.erase(unique(neighbours.begin(), neighbours.end()), neighbours.end());
+            for (unsigned int neighbour : neighbours)
+                pushCollapse(heap, vertices, quadrics, locked, version, to, neighbour);
+        }
+
+        vector<unsigned int> result;
+        result.reserve(liveTriangles * 3);
+        for (size_t t = 0; t < triangleCount; t++)
+            if (!removedTriangle[t])
+                result.insert(result.end(), triangles.begin() + t * 3, triangles.begin() + t * 3 + 3);
+        return result;
+    }
+
+private:
+    // symmetric 4x4 matrix of the plane equations, upper triangle
+    struct Quadric {
+        double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2;
+
+        Quadric() : a2(0), ab(0), ac(0), ad(0), b2(0), bc(0), bd(0), c2(0), cd(0), d2(0) {}
+
+        Quadric(const glm::vec3 &n, float d)
+            : a2(n.x * n.x), ab(n.x * n.y), ac(n.x * n.z), ad(n.x * d), b2(n.y * n.y), bc(n.y * n.z), bd(n.y * d),
+              c2(n.z * n.z), cd(n.z * d), d2(d * d) {}
+
+        Quadric &operator+=(const Quadric &q)
+        {
+            a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad; b2 += q.b2;
+            bc += q.bc; bd += q.bd; c2 += q.c2; cd += q.cd; d2 += q.d2;
+            return *this;
+        }
+
+        // sum of squared distances of p to the planes
+        double error(const glm::vec3 &p) const
+        {
+            double x = p.x, y = p.y, z = p.z;
+            return a2 * x * x + 2 * ab * x * y + 2 * ac * x * z + 2 * ad * x
+                 + b2 * y * y + 2 * bc * y * z + 2 * bd * y
+                 + c2 * z * z + 2 * cd * z + d2;
+        }
+    };
+
+    // moves vertex from onto vertex to
+    struct Collapse {
+        double cost;
+        unsigned int from, to;
+        unsigned int fromVersion, toVersion;
+
+        bool operator>(const Collapse &other) const
+        {
+            return cost > other.cost;
+        }
+    };
+
+    static void pushCollapse(priority_queue<Collapse, vector<Collapse>, greater<Collapse>> &heap, const vector<Vertex> &vertices,
+                             const vector<Quadric> &quadrics, const vector<bool> &locked, const vector<unsigned int> &version,
+                             unsigned int a, unsigned int b)
+    {
+        if (locked[a] && locked[b])
+            return;
+        Quadric q = quadrics[a];
+        q += quadrics[b];
+        // the cheaper direction, a locked vertex can only be collapsed onto
+        double aOntoB = locked[a] ? INFINITY : q.error(vertices[b].Position);
+        double bOntoA = locked[b] ? INFINITY : q.error(vertices[a].Position);
+        if (aOntoB <= bOntoA)
+            heap.push({aOntoB, a, b, version[a], version[b]});
+        else
+            heap.push({bOntoA, b, a, version[b], version[a]});
+    }
+
+    // would moving vertex from onto vertex to turn one of from's remaining triangles over
+    static bool flipsTriangle(const vector<Vertex> &vertices, const vector<unsigned int> &triangles,
+                              const vector<unsigned int> &fromTriangles, const vector<bool> &removedTriangle,
+                              unsigned int from, unsigned int to)
+    {
+        for (unsigned int t : fromTriangles) {
+            if (removedTriangle[t])
+                continue;
+            const unsigned int *triangle = &triangles[t * 3];
+            if (triangle[0] == to || triangle[1] == to || triangle[2] == to)
+                continue; // collapses away
+            glm::vec3 before[3], after[3];
+            for (int k = 0; k < 3; k++) {
+                before[k] = after[k] = vertices[triangle[k]].Position;
+                if (triangle[k] == from)
+                    after[k] = vertices[to].Position;
+            }
+            glm::vec3 normalBefore = glm::cross(before[1] - before[0], before[2] - before[0]);
+            glm::vec3 normalAfter = glm::cross(after[1] - after[0], after[2] - after[0]);
+            if (glm::dot(normalBefore, normalAfter) <= 0.0f)
+                return true;
+        }
+        return false;
+    }
+};
+#endif
@@ -11,7 +11,11 @@
 #include <assimp/postprocess.h>
 
 #include <learnopengl/mesh.h>
+#include <learnopengl/mesh_cache.h>
+#include <learnopengl/mesh_optimizer.h>
+#include <learnopengl/mesh_simplifier.h>
 #include <learnopengl/shader.h>
+#include <learnopengl/texture_cache.h>
 
 #include <string>
 #include <fstream>
@@ -28,80 +32,295 @@ unsigned int TextureFromFile(const char *path, const string &directory, bool gam
 class Model
 {
 public:
+    // post-processing steps every model is imported with; part of the mesh cache key
+    static const unsigned int importFlags = aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace;
+
     // model data
-    vector<Texture> textures_loaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
     vector<Mesh>    meshes;
+    // the file's node hierarchy, flattened with parents before children, and every node's transform relative to the model
+    vector<ModelNode> nodes;
+    vector<glm::mat4> nodeWorld;
     string directory;
     bool gammaCorrection;
+    // vertex buffer layout of the meshes, has to be chosen before upload()
+    VertexLayout vertexLayout = VertexLayout::full();
 
     // constructor, expects a filepath to a 3D model.
     Model(string const &path, bool gamma = false) : gammaCorrection(gamma)
+    {
+        load(path);
+        upload();
+    }
+
+    // creates an empty model, fill it with load() followed by upload().
+    Model() : gammaCorrection(false) {}
+
+    // CPU stage: imports the model (or reads it from the mesh cache) and requests its textures from the TextureCache.
+    // doesn't touch OpenGL, so models can be loaded concurrently on worker threads.
+    void load(string const &path)
     {
         loadModel(path);
     }
 
-    // draws the model, and thus all its meshes
+    // GL stage: creates the textures and vertex buffers for everything load() produced.
+    // has to run on the thread that owns the GL context. Textures still waiting in the TextureCache
+    // (e.g. because nobody ran TextureCache::decodePending) are decoded here.
+    void upload()
+    {
+        TextureCache &textureCache = TextureCache::instance();
+        textureCache.uploadPending();
+
+        for (MeshData &mesh : pendingMeshes)
+        {
+            for (Texture &texture : mesh.textures)
+                texture.id = textureCache.id(texture.path);
+            meshes.push_back(Mesh(mesh.vertices, mesh.indices, mesh.textures, mesh.bounds, vertexLayout, mesh.lods));
+            meshes.back().node = mesh.node;
+        }
+        pendingMeshes.clear();
+
+        // instance buffer shared by all meshes, starts with a single identity matrix so plain draws never read past its end
+        glm::mat4 identity(1.0f);
+        glGenBuffers(1, &instanceVBO);
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(glm::mat4), &identity, GL_STREAM_DRAW);
+        instanceCapacity = 1;
+        for (Mesh &mesh : meshes)
+            mesh.setupInstanceAttributes(instanceVBO);
+    }
+
+    // recomputes nodeWorld from the nodes' local transforms in one pass, parents come first so theirs are done already.
+    // change a node's local transform and call this to move a part of the model, the geometry stays as it is.
+    void updateNodeTransforms()
+    {
+        nodeWorld.resize(nodes.size());
+        for (unsigned int i = 0; i < nodes.size(); i++)
+            nodeWorld[i] = nodes[i].parent < 0 ? nodes[i].local : nodeWorld[nodes[i].parent] * nodes[i].local;
+    }
+
+    // transform from a mesh's vertices to model space
+    const glm::mat4 &meshTransform(unsigned int mesh) const
+    {
+        return nodeWorld[meshes[mesh].node];
+    }
+
+    // draws the model, and thus all its meshes. node transforms aren't applied here, the scene draws
+    // (see SceneCuller) fold them into the instance matrices
     void Draw(Shader &shader)
     {
         for(unsigned int i = 0; i < meshes.size(); i++)
             meshes[i].Draw(shader);
     }
 
+    // draws one copy of the model per transform, with a single instanced draw call per mesh.
+    // the shader selects aInstanceModel over the model uniform through its "instanced" uniform.
+    void DrawInstanced(Shader &shader, const vector<glm::mat4> &transforms)
+    {
+        DrawInstanced(shader, transforms.data(), transforms.size());
+    }
+
+    void DrawInstanced(Shader &shader, const glm::mat4 *transforms, unsigned int count)
+    {
+        if (count == 0)
+            return;
+
+        glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+        if (count > instanceCapacity)
+        {
+            instanceCapacity = count;
+            glBufferData(GL_ARRAY_BUFFER, instanceCapacity * sizeof(glm::mat4), transforms, GL_STREAM_DRAW);
+        }
+        else
+        {
+            // orphan the old storage so we don't wait for draws still reading it
+            glBufferData(GL_ARRAY_BUFFER, instanceCapacity * sizeof(glm::mat4), nullptr, GL_STREAM_DRAW);
+            glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(glm::mat4), transforms);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        GLint instancedLocation = shader.location("instanced");
+        glUniform1i(instancedLocation, 1);
+        for(unsigned int i = 0; i < meshes.size(); i++)
+        {
+            meshes[i].setInstanceSource(instanceVBO, 0);
+            meshes[i].DrawInstanced(shader, count);
+        }
+        glUniform1i(instancedLocation, 0);
+    }
+
+    size_t vertexCount() const
+    {
+        size_t count = 0;
+        for (const Mesh &mesh : meshes)
+            count += mesh.vertices.size();
+        return count;
+    }
+
+    // GPU memory of all vertex and index buffers
+    size_t vertexBufferBytes() const
+    {
+        size_t bytes = 0;
+        for (const Mesh &mesh : meshes)
+            bytes += mesh.vertexBufferBytes();
+        return bytes;
+    }
+
+    size_t indexBufferBytes() const
+    {
+        size_t bytes = 0;
+        for (const Mesh &mesh : meshes)
+            bytes += mesh.indexBufferBytes();
+        return bytes;
+    }
+
     void SetShaderTextureNamePrefix(std::string prefix) {
         for (Mesh& mesh: meshes) {
-            mesh.glslIdentifierPrefix = prefix;
+            mesh.SetShaderTextureNamePrefix(prefix);
         }
     }
 private:
-    // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
+    // per-instance model matrices for DrawInstanced
+    unsigned int instanceVBO = 0;
+    size_t instanceCapacity = 0;
+
+    // output of load() waiting for upload(), texture paths are TextureCache keys
+    vector<MeshData> pendingMeshes;
+
+    // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the pendingMeshes vector.
+    // the processed meshes are read from the mesh cache when it has an up to date copy, Assimp only runs on a miss.
     void loadModel(string const &path)
     {
-        // read file via ASSIMP
-        Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
-        // check for errors
-        if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
-        {
-            cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
-            return;
-        }
         // retrieve the directory path of the filepath
         directory = path.substr(0, path.find_last_of('/'));
 
-        // process ASSIMP's root node recursively
-        processNode(scene->mRootNode, scene);
+        vector<MeshData> data;
+        nodes.clear();
+        if (!MeshCache::load(path, importFlags, data, nodes))
+        {
+            // read file via ASSIMP
+            Assimp::Importer importer;
+            const aiScene* scene = importer.ReadFile(path, importFlags);
+            // check for errors
+            if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
+            {
+                cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
+                return;
+            }
+
+            // process ASSIMP's root node recursively
+            processNode(scene->mRootNode, scene, data, -1);
+            optimizeMeshes(path, data);
+            MeshCache::store(path, importFlags, data, nodes);
+        }
+        updateNodeTransforms();
+
+        for (MeshData &mesh : data)
+        {
+            for (Texture &texture : mesh.textures)
+                texture.path = TextureCache::instance().request(directory + '/' + texture.path);
+            pendingMeshes.push_back(std::move(mesh));
+        }
+    }
+
+    // reorders the freshly imported meshes for the vertex cache and overdraw (see MeshOptimizer) and reports the gain.
+    // meshes too big for 16-bit indices are split into chunks when that pays off, then every mesh gets its levels of detail.
+    // runs before the mesh cache is written, so cached models are optimized already and skip this.
+    void optimizeMeshes(string const &path, vector<MeshData> &data)
+    {
+        // built up first, models are imported concurrently and their reports shouldn't interleave
+        ostringstream report;
+        report << "Mesh optimizer: " << path << endl;
+        vector<MeshData> optimized;
+        for (unsigned int i = 0; i < data.size(); i++)
+        {
+            MeshOptimizer::Report result = MeshOptimizer::optimize(data[i]);
+            data[i].bounds = computeBounds(data[i].vertices);
+            report << "  mesh " << i << ": " << result.triangles << " triangles, vertices "
+                   << result.verticesBefore << " -> " << result.verticesAfter
+                   << ", ACMR " << result.acmrBefore << " -> " << result.acmrAfter
+                   << ", ATVR " << result.atvrBefore << " -> " << result.atvrAfter;
+
+            vector<MeshData> chunks;
+            if (MeshOptimizer::splitForShortIndices(data[i], chunks))
+            {
+                report << ", split into " << chunks.size() << " meshes with 16-bit indices";
+                for (MeshData &chunk : chunks)
+                    optimized.push_back(std::move(chunk));
+            }
+            else
+            {
+                report << ", " << 8 * indexTypeSize(indexTypeFor(data[i].vertices.size())) << "-bit indices";
+                optimized.push_back(std::move(data[i]));
+            }
+            report << endl;
+        }
+        data.swap(optimized);
+
+        for (unsigned int i = 0; i < data.size(); i++)
+        {
+            MeshSimplifier::generateLods(data[i]);
+            if (data[i].lods.empty())
+                continue;
+            report << "  mesh " << i << " LODs:";
+            for (const MeshLod &lod : data[i].lods)
+                report << " " << lod.indices.size() / 3 << " triangles (error " << lod.error << ")";
+            report << endl;
+        }
+        cout << report.str();
     }
 
     // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-    void processNode(aiNode *node, const aiScene *scene)
+    // nodes are appended to the nodes array before their children, so it ends up in topological order.
+    void processNode(aiNode *node, const aiScene *scene, vector<MeshData> &data, int parent)
     {
+        ModelNode modelNode;
+        modelNode.parent = parent;
+        modelNode.local = toGlm(node->mTransformation);
+        modelNode.name = node->mName.C_Str();
+        unsigned int index = nodes.size();
+        nodes.push_back(modelNode);
+
         // process each mesh located at the current node
         for(unsigned int i = 0; i < node->mNumMeshes; i++)
         {
             // the node object only contains indices to index the actual objects in the scene.
             // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
             aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-            meshes.push_back(processMesh(mesh, scene));
+            data.push_back(processMesh(mesh, scene));
+            data.back().node = index;
         }
         // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
         for(unsigned int i = 0; i < node->mNumChildren; i++)
         {
-            processNode(node->mChildren[i], scene);
+            processNode(node->mChildren[i], scene, data, index);
         }
 
     }
 
-    Mesh processMesh(aiMesh *mesh, const aiScene *scene)
+    // Assimp matrices are row major, glm's column major
+    static glm::mat4 toGlm(const aiMatrix4x4 &m)
+    {
+        glm::mat4 result;
+        result[0] = glm::vec4(m.a1, m.b1, m.c1, m.d1);
+        result[1] = glm::vec4(m.a2, m.b2, m.c2, m.d2);
+        result[2] = glm::vec4(m.a3, m.b3, m.c3, m.d3);
+        result[3] = glm::vec4(m.a4, m.b4, m.c4, m.d4);
+        return result;
+    }
+
+    MeshData processMesh(aiMesh *mesh, const aiScene *scene)
     {
         // data to fill
-        vector<Vertex> vertices;
-        vector<unsigned int> indices;
-        vector<Texture> textures;
+        MeshData data;
+        vector<Vertex> &vertices = data.vertices;
+        vector<unsigned int> &indices = data.indices;
+        vector<Texture> &textures = data.textures;
 
         // walk through each of the mesh's vertices
         for(unsigned int i = 0; i < mesh->mNumVertices; i++)
         {
-            Vertex vertex;
+            // zeroed, attributes the mesh lacks are hashed and compared byte-wise by MeshOptimizer and cached
+            Vertex vertex{};
             glm::vec3 vector; // we declare a placeholder vector since assimp_ uses its own vector class that doesn't directly convert to glm's vec3 class so we transfer the data to this placeholder glm::vec3 first.
             // positions
             vector.x = mesh->mVertices[i].x;
@@ -164,53 +383,40 @@ private:
 
 
         // 1. diffuse maps
-        vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
+        vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, TEXTURE_DIFFUSE);
         textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
         // 2. specular maps
-        vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
+        vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, TEXTURE_SPECULAR);
         textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
         // 3. normal maps
-        std::vector<Texture> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, "texture_normal");
+        std::vector<Texture> normalMaps = loadMaterialTextures(material, aiTextureType_HEIGHT, TEXTURE_NORMAL);
         textures.insert(textures.end(), normalMaps.begin(), normalMaps.end());
         // 4. height maps
-        std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, "texture_height");
+        std::vector<Texture> heightMaps = loadMaterialTextures(material, aiTextureType_AMBIENT, TEXTURE_HEIGHT);
         textures.insert(textures.end(), heightMaps.begin(), heightMaps.end());
 
 
 
-        // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures);
+        data.bounds = computeBounds(vertices);
+
+        // return the extracted mesh data, textures are resolved by upload
+        return data;
     }
 
-    // checks all material textures of a given type and loads the textures if they're not loaded yet.
-    // the required info is returned as a Texture struct.
-    vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, string typeName)
+    // collects all material textures of a given type.
+    // the required info is returned as Texture structs whose ids are filled in by upload.
+    vector<Texture> loadMaterialTextures(aiMaterial *mat, aiTextureType type, TextureType typeName)
     {
         vector<Texture> textures;
         for(unsigned int i = 0; i < mat->GetTextureCount(type); i++)
         {
             aiString str;
             mat->GetTexture(type, i, &str);
-            // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-            bool skip = false;
-            for(unsigned int j = 0; j < textures_loaded.size(); j++)
-            {
-                if(std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
-                {
-                    textures.push_back(textures_loaded[j]);
-                    skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-                    break;
-                }
-            }
-            if(!skip)
-            {   // if texture hasn't been loaded already, load it
-                Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
-                texture.type = typeName;
-                texture.path = str.C_Str();
-                textures.push_back(texture);
-                textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
-            }
+            Texture texture;
+            texture.id = 0;
+            texture.type = typeName;
+            texture.path = str.C_Str();
+            textures.push_back(texture);
         }
         return textures;
     }
@@ -219,41 +425,8 @@ private:
 
 unsigned int TextureFromFile(const char *path, const string &directory, bool gamma)
 {
-    string filename = string(path);
-    filename = directory + '/' + filename;
-
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data)
-    {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
-    }
-    else
-    {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
-    }
-
-    return textureID;
+    string filename = directory + '/' + string(path);
+    TextureData texture = DecodeTexture(filename);
+    return UploadTexture(texture, filename);
 }
 #endif
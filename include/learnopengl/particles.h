@@ -0,0 +1,129 @@
+#ifndef PARTICLES_H
+#define PARTICLES_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/shader.h>
+
+#include <algorithm>
+#include <random>
+#include <vector>
+using namespace std;
+
+// Firefly particles simulated entirely on the GPU. The state of every particle lives in one of two vertex buffers;
+// each frame firefly_update.vs reads one and transform feedback writes the other (with rasterization off), then the
+// freshly written buffer is drawn as point sprites into the HDR framebuffer, color and bright color both, so the
+// particles glow through bloom. Two draw calls a frame whatever the count, the CPU never touches a particle after
+// init().
+class FireflyParticles
+{
+public:
+    bool enabled = true;
+    unsigned int count = 0;
+    // world space diameter of a sprite
+    float size = 0.08f;
+
+    // scatters count particles in the box center +- extent, needs a current context. the update shader has to be
+    // linked with outPosition and outVelocity as feedback varyings
+    void init(unsigned int count, glm::vec3 center, glm::vec3 extent, Shader &updateShader, Shader &drawShader)
+    {
+        this->count = count;
+
+        // position (xyz, flicker phase) and velocity (xyz, wander speed), the same layout the update shader writes
+        vector<glm::vec4> particles(count * 2);
+        mt19937 random(11);
+        uniform_real_distribution<float> unit(-1.0f, 1.0f);
+        uniform_real_distribution<float> phase(0.0f, glm::radians(360.0f));
+        uniform_real_distribution<float> speed(0.3f, 1.2f);
+        for (unsigned int i = 0; i < count; i++) {
+            glm::vec3 position = center + extent * glm::vec3(unit(random), unit(random), unit(random));
+            particles[i * 2] = glm::vec4(position, phase(random));
+            particles[i * 2 + 1] = glm::vec4(0.0f, 0.0f, 0.0f, speed(random));
+        }
+
+        glGenBuffers(2, buffers);
+        glGenVertexArrays(2, vaos);
+        for (unsigned int i = 0; i < 2; i++) {
+            glBindVertexArray(vaos[i]);
+            glBindBuffer(GL_ARRAY_BUFFER, buffers[i]);
+            glBufferData(GL_ARRAY_BUFFER, particles.size() * sizeof(glm::vec4), particles.data(), GL_DYNAMIC_COPY);
+            glEnableVertexAttribArray(0);
+            glVertexAttribPointer(0, 4, GL_FLOAT, GL_FALSE, 2 * sizeof(glm::vec4), (void*)0);
+            glEnableVertexAttribArray(1);
+            glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, 2 * sizeof(glm::vec4), (void*)sizeof(glm::vec4));
+        }
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+        timeUniform = updateShader.uniform<float>("time");
+        deltaTimeUniform = updateShader.uniform<float>("deltaTime");
+        updateShader.use();
+        updateShader.setVec3("boundsCenter", center);
+        updateShader.setVec3("boundsExtent", extent);
+        drawTimeUniform = drawShader.uniform<float>("time");
+        colorUniform = drawShader.uniform<glm::vec3>("color");
+        pointScaleUniform = drawShader.uniform<float>("pointScale");
+    }
+
+    // advances the particles by deltaTime (clamped, so a stall or a restarted clock doesn't scatter them)
+    void update(Shader &updateShader, float time, float deltaTime)
+    {
+        if (count == 0)
+            return;
+        updateShader.use();
+        updateShader.set(timeUniform, time);
+        updateShader.set(deltaTimeUniform, min(max(deltaTime, 0.0f), 0.1f));
+        glEnable(GL_RASTERIZER_DISCARD);
+        glBindVertexArray(vaos[current]);
+        glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, buffers[1 - current]);
+        glBeginTransformFeedback(GL_POINTS);
+        glDrawArrays(GL_POINTS, 0, count);
+        glEndTransformFeedback();
+        glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+        glBindVertexArray(0);
+        glDisable(GL_RASTERIZER_DISCARD);
+        current = 1 - current;
+    }
+
+    // draws the particles additively into the bound framebuffer, depth tested but not written.
+    // pointScale is the sprite size in pixels of one world unit at distance one (projection[1][1] * height / 2)
+    void draw(Shader &drawShader, glm::vec3 color, float time, float pointScale)
+    {
+        if (count == 0)
+            return;
+        drawShader.use();
+        drawShader.set(drawTimeUniform, time);
+        drawShader.set(colorUniform, color);
+        drawShader.set(pointScaleUniform, pointScale * size);
+        glEnable(GL_PROGRAM_POINT_SIZE);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_ONE, GL_ONE);
+        glDepthMask(GL_FALSE);
+        glBindVertexArray(vaos[current]);
+        glDrawArrays(GL_POINTS, 0, count);
+        glBindVertexArray(0);
+        glDepthMask(GL_TRUE);
+        glDisable(GL_BLEND);
+        glDisable(GL_PROGRAM_POINT_SIZE);
+    }
+
+    void destroy()
+    {
+        glDeleteVertexArrays(2, vaos);
+        glDeleteBuffers(2, buffers);
+        count = 0;
+    }
+
+private:
+    GLuint buffers[2] = {0, 0};
+    GLuint vaos[2] = {0, 0};
+    // the buffer holding the latest state
+    unsigned int current = 0;
+    Uniform<float> timeUniform;
+    Uniform<float> deltaTimeUniform;
+    Uniform<float> drawTimeUniform;
+    Uniform<glm::vec3> colorUniform;
+    Uniform<float> pointScaleUniform;
+};
+#endif
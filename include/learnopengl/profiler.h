@@ -0,0 +1,216 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <glad/glad.h>
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+using namespace std;
+
+// CPU and GPU time of named sections of a frame. GPU times come from GL_TIMESTAMP queries at the start and end
+// of every section; the queries of a frame are read back FRAMES_IN_FLIGHT frames later, when the GPU is done with
+// them, so reading them never stalls. A frame whose queries still aren't done by then is dropped.
+// Sections can nest, they're listed in the order they first ran. "Frame" is the whole frame (beginFrame to endFrame).
+class Profiler
+{
+public:
+    static const unsigned int FRAMES_IN_FLIGHT = 3;
+    // samples kept per section for the rolling averages and plots
+    static const unsigned int HISTORY = 240;
+
+    struct Section {
+        string name;
+        // HISTORY samples in milliseconds, a ring buffer with the newest at historyHead - 1
+        vector<float> cpuHistory;
+        vector<float> gpuHistory;
+        // over the history, of the frames the section ran in
+        float cpuAverage = 0.0f;
+        float gpuAverage = 0.0f;
+    };
+
+    bool enabled = true;
+    vector<Section> sections;
+    unsigned int historyHead = 0;
+
+    // starts writing every resolved frame as "frame,section,cpu_ms,gpu_ms" lines to path
+    bool openCsv(const string &path)
+    {
+        csv.open(path);
+        if (!csv) {
+            cout << "ERROR::PROFILER:: can't write " << path << endl;
+            return false;
+        }
+        csv << "frame,section,cpu_ms,gpu_ms" << endl;
+        return true;
+    }
+
+    void beginFrame()
+    {
+        frameEnabled = enabled;
+        if (!frameEnabled)
+            return;
+        FrameSlot &slot = slots[frame % FRAMES_IN_FLIGHT];
+        resolve(slot);
+        slot.frame = frame;
+        slot.usedQueries = 0;
+        slot.samples.clear();
+        begin("Frame");
+    }
+
+    void endFrame()
+    {
+        if (!frameEnabled)
+            return;
+        end();
+        slots[frame % FRAMES_IN_FLIGHT].pending = true;
+        frame++;
+    }
+
+    void begin(const char *name)
+    {
+        if (!frameEnabled)
+            return;
+        FrameSlot &slot = slots[frame % FRAMES_IN_FLIGHT];
+        Sample sample;
+        sample.section = sectionIndex(name);
+        sample.beginQuery = query(slot);
+        sample.endQuery = 0;
+        sample.cpuStart = chrono::steady_clock::now();
+        sample.cpuMilliseconds = 0.0f;
+        glQueryCounter(sample.beginQuery, GL_TIMESTAMP);
+        open.push_back(slot.samples.size());
+        slot.samples.push_back(sample);
+    }
+
+    void end()
+    {
+        if (!frameEnabled || open.empty())
+            return;
+        FrameSlot &slot = slots[frame % FRAMES_IN_FLIGHT];
+        Sample &sample = slot.samples[open.back()];
+        open.pop_back();
+        sample.endQuery = query(slot);
+        glQueryCounter(sample.endQuery, GL_TIMESTAMP);
+        sample.cpuMilliseconds = chrono::duration<float, milli>(chrono::steady_clock::now() - sample.cpuStart).count();
+    }
+
+    void destroy()
+    {
+        for (FrameSlot &slot : slots) {
+            if (!slot.queries.empty())
+                glDeleteQueries(slot.queries.size(), slot.queries.data());
+            slot.queries.clear();
+        }
+    }
+
+private:
+    struct Sample {
+        unsigned int section;
+        GLuint beginQuery, endQuery;
+        chrono::steady_clock::time_point cpuStart;
+        float cpuMilliseconds;
+    };
+
+    // the queries and samples of one frame in flight
+    struct FrameSlot {
+        vector<GLuint> queries;
+        unsigned int usedQueries = 0;
+        vector<Sample> samples;
+        uint64_t frame = 0;
+        bool pending = false;
+    };
+
+    FrameSlot slots[FRAMES_IN_FLIGHT];
+    uint64_t frame = 0;
+    bool frameEnabled = false;
+    // samples begun but not ended yet, innermost last
+    vector<size_t> open;
+    ofstream csv;
+
+    unsigned int sectionIndex(const char *name)
+    {
+        for (unsigned int i = 0; i < sections.size(); i++)
+            if (sections[i].name == name)
+                return i;
+        Section section;
+        section.name = name;
+        section.cpuHistory.assign(HISTORY, 0.0f);
+        section.gpuHistory.assign(HISTORY, 0.0f);
+        sections.push_back(section);
+        return sections.size() - 1;
+    }
+
+    GLuint query(FrameSlot &slot)
+    {
+        if (slot.usedQueries == slot.queries.size()) {
+            GLuint id;
+            glGenQueries(1, &id);
+            slot.queries.push_back(id);
+        }
+        return slot.queries[slot.usedQueries++];
+    }
+
+    // reads back the slot's queries if the GPU got through them, and adds the frame to the history
+    void resolve(FrameSlot &slot)
+    {
+        if (!slot.pending)
+            return;
+        slot.pending = false;
+        // timestamps complete in order, so the frame's last query being done means all of them are
+        GLint available = 0;
+        glGetQueryObjectiv(slot.samples.front().endQuery, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            return;
+
+        vector<float> cpu(sections.size(), 0.0f), gpu(sections.size(), 0.0f);
+        for (const Sample &sample : slot.samples) {
+            GLuint64 start = 0, stop = 0;
+            glGetQueryObjectui64v(sample.beginQuery, GL_QUERY_RESULT, &start);
+            glGetQueryObjectui64v(sample.endQuery, GL_QUERY_RESULT, &stop);
+            // a section running more than once a frame adds up
+            cpu[sample.section] += sample.cpuMilliseconds;
+            gpu[sample.section] += (stop - start) / 1.0e6f;
+            if (csv)
+                csv << slot.frame << ',' << sections[sample.section].name << ',' << sample.cpuMilliseconds << ','
+                    << (stop - start) / 1.0e6f << '\n';
+        }
+
+        for (unsigned int i = 0; i < sections.size(); i++) {
+            Section &section = sections[i];
+            section.cpuHistory[historyHead] = cpu[i];
+            section.gpuHistory[historyHead] = gpu[i];
+            float cpuSum = 0.0f, gpuSum = 0.0f;
+            unsigned int samples = 0;
+            for (unsigned int h = 0; h < HISTORY; h++) {
+                if (section.cpuHistory[h] == 0.0f && section.gpuHistory[h] == 0.0f)
+                    continue;
+                cpuSum += section.cpuHistory[h];
+                gpuSum += section.gpuHistory[h];
+                samples++;
+            }
+            section.cpuAverage = samples ? cpuSum / samples : 0.0f;
+            section.gpuAverage = samples ? gpuSum / samples : 0.0f;
+        }
+        historyHead = (historyHead + 1) % HISTORY;
+    }
+};
+
+// times the enclosing block as a section
+struct ProfileScope {
+    Profiler &profiler;
+
+    ProfileScope(Profiler &profiler, const char *name) : profiler(profiler)
+    {
+        profiler.begin(name);
+    }
+
+    ~ProfileScope()
+    {
+        profiler.end();
+    }
+};
+#endif
@@ -0,0 +1,361 @@
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <glad/glad.h>
+
+#include <learnopengl/indirect_draw.h>
+#include <learnopengl/mesh.h>
+#include <learnopengl/profiler.h>
+#include <learnopengl/shader.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+using namespace std;
+
+// coarse draw order, everything in a layer is drawn before the next one no matter how it sorts
+enum RenderLayer {
+    RENDER_LAYER_GBUFFER, // deferred geometry, lit before the opaque layer
+    RENDER_LAYER_OPAQUE,
+    RENDER_LAYER_SKY, // needs the depth of everything opaque
+    RENDER_LAYER_COUNT
+};
+
+inline const char *renderLayerName(RenderLayer layer)
+{
+    switch (layer) {
+    case RENDER_LAYER_GBUFFER: return "G-buffer";
+    case RENDER_LAYER_OPAQUE: return "Opaque";
+    case RENDER_LAYER_SKY: return "Sky";
+    case RENDER_LAYER_COUNT: break;
+    }
+    return "Unknown";
+}
+
+// one draw of a frame, either of a Mesh or of glDrawArraysInstanced on a plain VAO. Draws are always instanced,
+// the queue sets the program's "instanced" uniform.
+struct DrawItem {
+    uint64_t key = 0;
+    RenderLayer layer = RENDER_LAYER_OPAQUE;
+    Shader *shader = nullptr;
+    GLuint vao = 0;
+    // first texture, the others of a mesh follow on units 1, 2, ...
+    GLenum textureTarget = GL_TEXTURE_2D;
+    GLuint texture = 0;
+    bool cullFace = true;
+    GLenum depthFunc = GL_LESS;
+    // optional float material parameter (e.g. shininess), set when it differs from the last one set
+    GLint materialLocation = -1;
+    float material = 0.0f;
+    GLsizei instanceCount = 1;
+
+    // mesh draws, of one of the mesh's levels of detail
+    Mesh *mesh = nullptr;
+    unsigned int lod = 0;
+    GLuint instanceBuffer = 0;
+    size_t instanceOffset = 0;
+    // or instances from the IndirectDraws records, starting at firstRecord
+    bool indirect = false;
+    GLuint firstRecord = 0;
+
+    // array draws
+    GLenum mode = GL_TRIANGLES;
+    GLint first = 0;
+    GLsizei count = 0;
+};
+
+// Collects the draws of a frame and issues them sorted by a packed 64-bit key, so draws sharing a program,
+// cull/depth state, texture and VAO end up next to each other and redundant state changes are skipped.
+// Key layout, most significant first:
+//   layer (4) | program (8) | depth func (3) | cull (1) | texture (24) | VAO (24)
+// Draws with equal keys keep their submission order, the sort compares (key, item index) pairs.
+class RenderQueue
+{
+public:
+    // state changes a frame needs, counted between consecutive draws
+    struct Stats {
+        unsigned int draws = 0;
+        unsigned int programs = 0;
+        unsigned int textures = 0;
+        unsigned int vaos = 0;
+        unsigned int cullStates = 0;
+        unsigned int depthStates = 0;
+    };
+
+    // of the last flush(): in submission order and in sorted (issued) order
+    Stats unsortedStats;
+    Stats sortedStats;
+    // GL draw calls of the last flush(), a multi-draw counts once
+    unsigned int drawCalls = 0;
+    // CPU time of the last flush(), sorting and issuing the GL calls (not GPU time)
+    double flushMilliseconds = 0.0;
+    bool sortEnabled = true;
+    // needed for submitMeshIndirect, consecutive indirect draws sharing all state go out as one multi-draw
+    IndirectDraws *indirectDraws = nullptr;
+    // when set, every layer flush() draws is a profiler section of its own
+    Profiler *profiler = nullptr;
+    // called by flush() before drawing each layer, empty ones too, to switch framebuffers or run passes in between.
+    // it may change any GL state, the queue doesn't assume anything about it afterwards
+    function<void(RenderLayer)> beforeLayer;
+
+    void submitMesh(RenderLayer layer, Shader &shader, Mesh &mesh, bool cullFace, GLuint instanceBuffer,
+                    size_t instanceOffset, GLsizei instanceCount, GLint materialLocation = -1, float material = 0.0f,
+                    unsigned int lod = 0)
+    {
+        DrawItem item;
+        item.layer = layer;
+        item.shader = &shader;
+        item.vao = mesh.VAO;
+        item.texture = mesh.textures.empty() ? 0 : mesh.textures[0].id;
+        item.cullFace = cullFace;
+        item.materialLocation = materialLocation;
+        item.material = material;
+        item.instanceCount = instanceCount;
+        item.mesh = &mesh;
+        item.instanceBuffer = instanceBuffer;
+        item.instanceOffset = instanceOffset;
+        item.lod = lod;
+        submit(item);
+    }
+
+    // draws instanceCount instances whose model matrix and material come from records firstRecord... of indirectDraws
+    void submitMeshIndirect(RenderLayer layer, Shader &shader, Mesh &mesh, bool cullFace, GLuint firstRecord, GLsizei instanceCount,
+                            unsigned int lod = 0)
+    {
+        DrawItem item;
+        item.layer = layer;
+        item.shader = &shader;
+        item.vao = mesh.VAO;
+        item.texture = mesh.textures.empty() ? 0 : mesh.textures[0].id;
+        item.cullFace = cullFace;
+        item.instanceCount = instanceCount;
+        item.mesh = &mesh;
+        item.indirect = true;
+        item.firstRecord = firstRecord;
+        item.lod = lod;
+        submit(item);
+    }
+
+    void submitArrays(RenderLayer layer, Shader &shader, GLuint vao, GLenum textureTarget, GLuint texture,
+                      GLsizei count, GLsizei instanceCount, bool cullFace, GLenum depthFunc = GL_LESS)
+    {
+        DrawItem item;
+        item.layer = layer;
+        item.shader = &shader;
+        item.vao = vao;
+        item.textureTarget = textureTarget;
+        item.texture = texture;
+        item.cullFace = cullFace;
+        item.depthFunc = depthFunc;
+        item.count = count;
+        item.instanceCount = instanceCount;
+        submit(item);
+    }
+
+    // sorts and issues every submitted draw, then empties the queue. leaves face culling enabled,
+    // the depth func at GL_LESS, texture unit 0 active and no VAO bound.
+    void flush()
+    {
+        auto start = chrono::steady_clock::now();
+        order.clear();
+        for (unsigned int i = 0; i < items.size(); i++)
+            order.push_back({items[i].key, i});
+        unsortedStats = countStateChanges();
+        if (sortEnabled)
+            sort(order.begin(), order.end());
+        sortedStats = countStateChanges();
+
+        // GL state is unknown at the start, code outside the queue changes it freely
+        Shader *program = nullptr;
+        int indirect = -1;
+        GLuint vao = 0;
+        int cullFace = -1;
+        GLenum depthFunc = GL_NONE;
+        GLint materialLocation = -1;
+        float material = 0.0f;
+        // sampler locations of the program last pointed at units 0, 1, ... (meshes with the same texture kinds share them)
+        vector<GLint> samplerLocations;
+        GLuint boundTextures[MAX_TEXTURE_UNITS]; // 2D texture of every unit
+        auto forgetState = [&]() {
+            program = nullptr;
+            samplerLocations.clear();
+            vao = 0;
+            cullFace = -1;
+            depthFunc = GL_NONE;
+            fill(boundTextures, boundTextures + MAX_TEXTURE_UNITS, UNKNOWN_TEXTURE);
+            if (indirectDraws)
+                indirectDraws->bindRecords();
+        };
+        forgetState();
+        drawCalls = 0;
+        int layer = -1;
+        // runs beforeLayer for the layers up to next
+        auto enterLayers = [&](int next) {
+            for (int skipped = layer + 1; skipped <= next && beforeLayer; skipped++) {
+                beforeLayer((RenderLayer) skipped);
+                forgetState();
+            }
+        };
+
+        for (size_t o = 0; o < order.size(); o++) {
+            DrawItem &item = items[order[o].second];
+            if ((int) item.layer != layer) {
+                if (profiler && layer >= 0)
+                    profiler->end();
+                enterLayers(item.layer);
+                layer = item.layer;
+                if (profiler)
+                    profiler->begin(renderLayerName(item.layer));
+            }
+            if (item.shader != program) {
+                program = item.shader;
+                program->use();
+                glUniform1i(program->location("instanced"), 1);
+                materialLocation = -1;
+                indirect = -1;
+                samplerLocations.clear();
+            }
+            if (item.mesh && (int) item.indirect != indirect) {
+                indirect = item.indirect;
+                glUniform1i(program->location("indirect"), indirect);
+            }
+            if ((int) item.cullFace != cullFace) {
+                cullFace = item.cullFace;
+                if (item.cullFace)
+                    glEnable(GL_CULL_FACE);
+                else
+                    glDisable(GL_CULL_FACE);
+            }
+            if (item.depthFunc != depthFunc) {
+                depthFunc = item.depthFunc;
+                glDepthFunc(depthFunc);
+            }
+            if (item.materialLocation >= 0 && (item.materialLocation != materialLocation || item.material != material)) {
+                materialLocation = item.materialLocation;
+                material = item.material;
+                glUniform1f(materialLocation, material);
+            }
+            if (item.vao != vao) {
+                vao = item.vao;
+                glBindVertexArray(vao);
+            }
+
+            if (item.mesh) {
+                Mesh &mesh = *item.mesh;
+                const vector<GLint> &locations = mesh.samplerLocations(*item.shader);
+                if (locations != samplerLocations) {
+                    for (unsigned int i = 0; i < locations.size() && i < MAX_TEXTURE_UNITS; i++)
+                        glUniform1i(locations[i], i);
+                    samplerLocations = locations;
+                }
+                for (unsigned int i = 0; i < mesh.textures.size() && i < MAX_TEXTURE_UNITS; i++) {
+                    if (boundTextures[i] != mesh.textures[i].id) {
+                        glActiveTexture(GL_TEXTURE0 + i);
+                        glBindTexture(GL_TEXTURE_2D, mesh.textures[i].id);
+                        boundTextures[i] = mesh.textures[i].id;
+                    }
+                }
+                if (item.indirect) {
+                    mesh.disableInstanceSource();
+                    // this draw and every following one that only differs in mesh offsets and records
+                    commands.clear();
+                    commands.push_back(command(item));
+                    while (o + 1 < order.size() && mergeable(item, items[order[o + 1].second])) {
+                        o++;
+                        commands.push_back(command(items[order[o].second]));
+                    }
+                    drawCalls += indirectDraws->draw(commands, mesh.indexType, program->location("drawOffset"));
+                    continue;
+                }
+                mesh.setInstanceSource(item.instanceBuffer, item.instanceOffset);
+                mesh.drawElementsInstanced(item.instanceCount, item.lod);
+                drawCalls++;
+            } else {
+                // only 2D bindings are tracked, other targets are always bound
+                if (item.textureTarget != GL_TEXTURE_2D || boundTextures[0] != item.texture) {
+                    glActiveTexture(GL_TEXTURE0);
+                    glBindTexture(item.textureTarget, item.texture);
+                    if (item.textureTarget == GL_TEXTURE_2D)
+                        boundTextures[0] = item.texture;
+                }
+                glDrawArraysInstanced(item.mode, item.first, item.count, item.instanceCount);
+                drawCalls++;
+            }
+        }
+        if (profiler && layer >= 0)
+            profiler->end();
+        enterLayers(RENDER_LAYER_COUNT - 1);
+
+        glBindVertexArray(0);
+        glActiveTexture(GL_TEXTURE0);
+        glEnable(GL_CULL_FACE);
+        glDepthFunc(GL_LESS);
+        items.clear();
+        flushMilliseconds = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    }
+
+private:
+    static const unsigned int MAX_TEXTURE_UNITS = 16;
+    static const GLuint UNKNOWN_TEXTURE = ~0u;
+
+    vector<DrawItem> items;
+    // (key, item index), sorted instead of the items themselves
+    vector<pair<uint64_t, unsigned int>> order;
+    vector<DrawElementsIndirectCommand> commands;
+
+    static DrawElementsIndirectCommand command(const DrawItem &item)
+    {
+        DrawElementsIndirectCommand command;
+        command.count = item.mesh->lodIndexCount(item.lod);
+        command.instanceCount = item.instanceCount;
+        command.firstIndex = item.mesh->firstIndex() + item.mesh->lodFirstIndex(item.lod);
+        command.baseVertex = item.mesh->baseVertex;
+        command.baseInstance = item.firstRecord;
+        return command;
+    }
+
+    // can b go out in the same multi-draw as a: same layer, program, state, VAO, index type and textures
+    static bool mergeable(const DrawItem &a, const DrawItem &b)
+    {
+        if (!b.indirect || b.layer != a.layer || b.shader != a.shader || b.vao != a.vao || b.cullFace != a.cullFace || b.depthFunc != a.depthFunc
+            || b.mesh->indexType != a.mesh->indexType || b.mesh->textures.size() != a.mesh->textures.size())
+            return false;
+        for (unsigned int i = 0; i < a.mesh->textures.size(); i++)
+            if (a.mesh->textures[i].id != b.mesh->textures[i].id)
+                return false;
+        return true;
+    }
+
+    void submit(DrawItem &item)
+    {
+        uint64_t depth = item.depthFunc - GL_NEVER; // GL_NEVER ... GL_ALWAYS are 8 consecutive values
+        item.key = (uint64_t) (item.layer & 0xF) << 60
+                 | (uint64_t) (item.shader->ID & 0xFF) << 52
+                 | (depth & 0x7) << 49
+                 | (uint64_t) item.cullFace << 48
+                 | (uint64_t) (item.texture & 0xFFFFFF) << 24
+                 | (uint64_t) (item.vao & 0xFFFFFF);
+        items.push_back(item);
+    }
+
+    Stats countStateChanges() const
+    {
+        Stats stats;
+        const DrawItem *previous = nullptr;
+        for (const pair<uint64_t, unsigned int> &entry : order) {
+            const DrawItem &item = items[entry.second];
+            stats.draws++;
+            stats.programs += !previous || previous->shader != item.shader;
+            stats.textures += !previous || previous->texture != item.texture || previous->textureTarget != item.textureTarget;
+            stats.vaos += !previous || previous->vao != item.vao;
+            stats.cullStates += !previous || previous->cullFace != item.cullFace;
+            stats.depthStates += !previous || previous->depthFunc != item.depthFunc;
+            previous = &item;
+        }
+        return stats;
+    }
+};
+#endif
@@ -0,0 +1,462 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <learnopengl/frame_constants.h>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+// Scene description read from a text file. One statement per line, '#' starts a comment, paths are quoted:
+//   model <name> "<path>"
+//   entity <model> <lit|moon|firefly> [position x y z] [scale s] [rotate ax ay az degrees] [shininess s]
+//          [double_sided] [swing ax ay az degrees frequency] [oscillate ax ay az fx fy fz phx phy phz] [name n]
+//   grass [position x y z] [scale s]
+//   dirlight [ambient r g b] [diffuse r g b] [specular r g b] [direction x y z] [from <entity>]
+//   pointlight [position x y z] [ambient r g b] [diffuse r g b] [specular r g b] [attenuation c l q]
+//              [attach <entity> ox oy oz] [flicker]
+//   spotlight [ambient r g b] [attenuation c l q] [cutoff inner outer]
+// swing rocks the entity around its rotation axis by degrees * cos(frequency * t), oscillate moves it by
+// amplitude * cos(frequency * t + phase) per axis (phases in degrees). An attached light follows the entity,
+// its offset turning with the entity's swing; a dirlight "from" an entity shines from it towards the origin.
+
+// shader an entity is drawn with, batches are grouped pass by pass in this order
+enum ScenePass {
+    SCENE_PASS_LIT,
+    SCENE_PASS_MOON,
+    SCENE_PASS_FIREFLY,
+    SCENE_PASS_COUNT
+};
+
+struct SceneModel {
+    string name;
+    string path;
+};
+
+// everything about one placed model except its world matrix, which lives in Scene::transforms at the same index
+struct SceneEntity {
+    unsigned int model = 0;
+    ScenePass pass = SCENE_PASS_LIT;
+    bool doubleSided = false;
+    bool animated = false;
+    float shininess = 1.0f;
+    float scale = 1.0f;
+    glm::vec3 position = glm::vec3(0.0f);
+    glm::vec3 rotationAxis = glm::vec3(0.0f, 1.0f, 0.0f);
+    float rotationAngle = 0.0f;
+    // animation parameters, see the format description above
+    float swingAmplitude = 0.0f;
+    float swingFrequency = 0.0f;
+    glm::vec3 oscillateAmplitude = glm::vec3(0.0f);
+    glm::vec3 oscillateFrequency = glm::vec3(0.0f);
+    glm::vec3 oscillatePhase = glm::vec3(0.0f);
+    // state of the last animate()
+    glm::vec3 currentPosition = glm::vec3(0.0f);
+    float currentAngle = 0.0f;
+    string name;
+};
+
+// consecutive entities sharing model and render state, drawn with one DrawInstanced
+struct SceneBatch {
+    ScenePass pass;
+    unsigned int model;
+    bool doubleSided;
+    float shininess;
+    unsigned int first;
+    unsigned int count;
+};
+
+struct SceneDirLight {
+    glm::vec3 direction = glm::vec3(0.0f, -1.0f, 0.0f);
+    glm::vec3 ambient = glm::vec3(0.0f);
+    glm::vec3 diffuse = glm::vec3(1.0f);
+    glm::vec3 specular = glm::vec3(0.0f);
+    int from = -1;
+};
+
+struct ScenePointLight {
+    glm::vec3 position = glm::vec3(0.0f);
+    glm::vec3 ambient = glm::vec3(0.0f);
+    glm::vec3 diffuse = glm::vec3(1.0f);
+    glm::vec3 specular = glm::vec3(1.0f);
+    float constant = 1.0f;
+    float linear = 0.09f;
+    float quadratic = 0.03f;
+    int attach = -1;
+    bool flicker = false;
+    string attachName;
+};
+
+struct SceneSpotLight {
+    glm::vec3 ambient = glm::vec3(0.0f);
+    float constant = 1.0f;
+    float linear = 0.09f;
+    float quadratic = 0.03f;
+    float cutOff = 12.0f;
+    float outerCutOff = 15.0f;
+};
+
+class Scene
+{
+public:
+    vector<SceneModel> models;
+    // sorted by batch after finalize(), transforms[i] is the world matrix of entities[i]
+    vector<SceneEntity> entities;
+    vector<glm::mat4> transforms;
+    vector<SceneBatch> batches;
+    vector<glm::mat4> grass;
+
+    SceneDirLight dirLight;
+    vector<ScenePointLight> pointLights;
+    SceneSpotLight torch;
+
+    // reads a scene file and finalizes it, broken lines are reported and skipped
+    bool load(const string &path)
+    {
+        ifstream in(path);
+        if (!in) {
+            cout << "ERROR::SCENE:: can't open " << path << endl;
+            return false;
+        }
+
+        string line;
+        for (unsigned int lineNumber = 1; getline(in, line); lineNumber++) {
+            size_t comment = line.find('#');
+            if (comment != string::npos)
+                line.erase(comment);
+            istringstream tokens(line);
+            string statement;
+            if (!(tokens >> statement))
+                continue;
+
+            bool ok;
+            if (statement == "model")
+                ok = parseModel(tokens);
+            else if (statement == "entity")
+                ok = parseEntity(tokens);
+            else if (statement == "grass")
+                ok = parseGrass(tokens);
+            else if (statement == "dirlight")
+                ok = parseDirLight(tokens);
+            else if (statement == "pointlight")
+                ok = parsePointLight(tokens);
+            else if (statement == "spotlight")
+                ok = parseSpotLight(tokens);
+            else
+                ok = false;
+            if (!ok)
+                cout << "ERROR::SCENE:: " << path << ':' << lineNumber << ": can't parse \"" << line << '"' << endl;
+        }
+
+        if (pointLights.size() > MAX_POINT_LIGHTS)
+            cout << "INFO::SCENE:: " << path << ": only the first " << MAX_POINT_LIGHTS << " point lights are used without clustered lighting" << endl;
+        finalize();
+        return true;
+    }
+
+    // index of the named model, -1 if there is none
+    int findModel(const string &name) const
+    {
+        for (unsigned int i = 0; i < models.size(); i++)
+            if (models[i].name == name)
+                return i;
+        return -1;
+    }
+
+    // index of the named entity, -1 if there is none. only valid until the next finalize()
+    int findEntity(const string &name) const
+    {
+        for (unsigned int i = 0; i < entities.size(); i++)
+            if (entities[i].name == name)
+                return i;
+        return -1;
+    }
+
+    // sorts the entities into batches, resolves light references and computes the transforms of static entities.
+    // has to be called again after adding entities.
+    void finalize()
+    {
+        stable_sort(entities.begin(), entities.end(), [](const SceneEntity &a, const SceneEntity &b) {
+            if (a.pass != b.pass)
+                return a.pass < b.pass;
+            if (a.model != b.model)
+                return a.model < b.model;
+            if (a.doubleSided != b.doubleSided)
+                return a.doubleSided < b.doubleSided;
+            return a.shininess < b.shininess;
+        });
+
+        batches.clear();
+        animatedEntities.clear();
+        transforms.resize(entities.size());
+        for (unsigned int i = 0; i < entities.size(); i++) {
+            const SceneEntity &entity = entities[i];
+            if (batches.empty() || batches.back().pass != entity.pass || batches.back().model != entity.model
+                || batches.back().doubleSided != entity.doubleSided || batches.back().shininess != entity.shininess)
+                batches.push_back({entity.pass, entity.model, entity.doubleSided, entity.shininess, i, 0});
+            batches.back().count++;
+            if (entity.animated)
+                animatedEntities.push_back(i);
+        }
+
+        // many lights can be attached, look names up once
+        unordered_map<string, int> entityIndices;
+        for (int i = (int) entities.size() - 1; i >= 0; i--)
+            if (!entities[i].name.empty())
+                entityIndices[entities[i].name] = i;
+        for (ScenePointLight &light : pointLights) {
+            auto entity = entityIndices.find(light.attachName);
+            light.attach = light.attachName.empty() || entity == entityIndices.end() ? -1 : entity->second;
+        }
+        dirLight.from = dirLightFromName.empty() ? -1 : findEntity(dirLightFromName);
+
+        for (unsigned int i = 0; i < entities.size(); i++) {
+            entities[i].currentPosition = entities[i].position;
+            entities[i].currentAngle = entities[i].rotationAngle;
+            transforms[i] = worldMatrix(entities[i]);
+        }
+    }
+
+    // moves the animated entities to time t, static ones keep the transforms finalize() gave them
+    void animate(float t)
+    {
+        for (unsigned int i : animatedEntities) {
+            SceneEntity &entity = entities[i];
+            entity.currentAngle = entity.rotationAngle + entity.swingAmplitude * cos(entity.swingFrequency * t);
+            entity.currentPosition = entity.position
+                    + entity.oscillateAmplitude * glm::cos(entity.oscillateFrequency * t + entity.oscillatePhase);
+            transforms[i] = worldMatrix(entity);
+        }
+    }
+
+    // writes the scene's lights at their animated positions to the lights block, up to MAX_POINT_LIGHTS point lights.
+    // the torch only gets its attenuation and cone, position, direction and colour are up to the caller.
+    void writeLights(LightsBlock &lights) const
+    {
+        lights.dirLight.direction = dirLight.from >= 0 ? -entities[dirLight.from].currentPosition : dirLight.direction;
+        lights.dirLight.ambient = dirLight.ambient;
+        lights.dirLight.diffuse = dirLight.diffuse;
+        lights.dirLight.specular = dirLight.specular;
+
+        lights.nrPointLights = min<size_t>(pointLights.size(), MAX_POINT_LIGHTS);
+        for (int i = 0; i < lights.nrPointLights; i++)
+            writePointLight(pointLights[i], lights.pointLights[i]);
+
+        lights.torch.ambient = torch.ambient;
+        lights.torch.constant = torch.constant;
+        lights.torch.linear = torch.linear;
+        lights.torch.quadratic = torch.quadratic;
+        lights.torch.cutOff = cos(glm::radians(torch.cutOff));
+        lights.torch.outerCutOff = cos(glm::radians(torch.outerCutOff));
+    }
+
+    // all point lights at their animated positions, in the same layout, for clustered lighting
+    void writePointLights(vector<PointLightStd140> &lights) const
+    {
+        lights.resize(pointLights.size());
+        for (unsigned int i = 0; i < pointLights.size(); i++)
+            writePointLight(pointLights[i], lights[i]);
+    }
+
+    static glm::mat4 worldMatrix(const SceneEntity &entity)
+    {
+        glm::mat4 model = glm::mat4(1.0f);
+        model = glm::translate(model, entity.currentPosition);
+        if (entity.currentAngle != 0.0f)
+            model = glm::rotate(model, entity.currentAngle, entity.rotationAxis);
+        model = glm::scale(model, glm::vec3(entity.scale));
+        return model;
+    }
+
+private:
+    vector<unsigned int> animatedEntities;
+    string dirLightFromName;
+
+    void writePointLight(const ScenePointLight &light, PointLightStd140 &block) const
+    {
+        block.position = light.position;
+        if (light.attach >= 0) {
+            const SceneEntity &entity = entities[light.attach];
+            glm::mat4 rotation = glm::rotate(glm::mat4(1.0f), entity.currentAngle, entity.rotationAxis);
+            block.position = entity.currentPosition + glm::vec3(rotation * glm::vec4(light.position, 0.0f));
+        }
+        block.ambient = light.ambient;
+        block.diffuse = light.diffuse;
+        block.specular = light.specular;
+        block.constant = light.constant;
+        block.linear = light.linear;
+        block.quadratic = light.quadratic;
+    }
+
+    static bool readVec3(istream &in, glm::vec3 &v)
+    {
+        return static_cast<bool>(in >> v.x >> v.y >> v.z);
+    }
+
+    bool parseModel(istringstream &tokens)
+    {
+        SceneModel model;
+        if (!(tokens >> model.name >> std::quoted(model.path)) || findModel(model.name) >= 0)
+            return false;
+        models.push_back(model);
+        return true;
+    }
+
+    bool parseEntity(istringstream &tokens)
+    {
+        SceneEntity entity;
+        string modelName, pass;
+        if (!(tokens >> modelName >> pass))
+            return false;
+        int model = findModel(modelName);
+        if (model < 0)
+            return false;
+        entity.model = model;
+        if (pass == "lit")
+            entity.pass = SCENE_PASS_LIT;
+        else if (pass == "moon")
+            entity.pass = SCENE_PASS_MOON;
+        else if (pass == "firefly")
+            entity.pass = SCENE_PASS_FIREFLY;
+        else
+            return false;
+
+        string option;
+        while (tokens >> option) {
+            bool ok;
+            if (option == "position")
+                ok = readVec3(tokens, entity.position);
+            else if (option == "scale")
+                ok = static_cast<bool>(tokens >> entity.scale);
+            else if (option == "rotate") {
+                ok = readVec3(tokens, entity.rotationAxis) && (tokens >> entity.rotationAngle);
+                entity.rotationAngle = glm::radians(entity.rotationAngle);
+            } else if (option == "shininess")
+                ok = static_cast<bool>(tokens >> entity.shininess);
+            else if (option == "double_sided")
+                ok = entity.doubleSided = true;
+            else if (option == "swing") {
+                ok = readVec3(tokens, entity.rotationAxis) && (tokens >> entity.swingAmplitude >> entity.swingFrequency);
+                entity.swingAmplitude = glm::radians(entity.swingAmplitude);
+                entity.animated = true;
+            } else if (option == "oscillate") {
+                ok = readVec3(tokens, entity.oscillateAmplitude) && readVec3(tokens, entity.oscillateFrequency)
+                     && readVec3(tokens, entity.oscillatePhase);
+                entity.oscillatePhase = glm::radians(entity.oscillatePhase);
+                entity.animated = true;
+            } else if (option == "name")
+                ok = static_cast<bool>(tokens >> entity.name);
+            else
+                ok = false;
+            if (!ok)
+                return false;
+        }
+        entities.push_back(entity);
+        return true;
+    }
+
+    bool parseGrass(istringstream &tokens)
+    {
+        glm::vec3 position(0.0f);
+        float scale = 1.0f;
+        string option;
+        while (tokens >> option) {
+            bool ok;
+            if (option == "position")
+                ok = readVec3(tokens, position);
+            else if (option == "scale")
+                ok = static_cast<bool>(tokens >> scale);
+            else
+                ok = false;
+            if (!ok)
+                return false;
+        }
+        glm::mat4 model = glm::mat4(1.0f);
+        model = glm::translate(model, position);
+        model = glm::scale(model, glm::vec3(scale));
+        grass.push_back(model);
+        return true;
+    }
+
+    bool parseDirLight(istringstream &tokens)
+    {
+        string option;
+        while (tokens >> option) {
+            bool ok;
+            if (option == "direction")
+                ok = readVec3(tokens, dirLight.direction);
+            else if (option == "ambient")
+                ok = readVec3(tokens, dirLight.ambient);
+            else if (option == "diffuse")
+                ok = readVec3(tokens, dirLight.diffuse);
+            else if (option == "specular")
+                ok = readVec3(tokens, dirLight.specular);
+            else if (option == "from")
+                ok = static_cast<bool>(tokens >> dirLightFromName);
+            else
+                ok = false;
+            if (!ok)
+                return false;
+        }
+        return true;
+    }
+
+    bool parsePointLight(istringstream &tokens)
+    {
+        ScenePointLight light;
+        string option;
+        while (tokens >> option) {
+            bool ok;
+            if (option == "position")
+                ok = readVec3(tokens, light.position);
+            else if (option == "ambient")
+                ok = readVec3(tokens, light.ambient);
+            else if (option == "diffuse")
+                ok = readVec3(tokens, light.diffuse);
+            else if (option == "specular")
+                ok = readVec3(tokens, light.specular);
+            else if (option == "attenuation")
+                ok = static_cast<bool>(tokens >> light.constant >> light.linear >> light.quadratic);
+            else if (option == "attach")
+                ok = (tokens >> light.attachName) && readVec3(tokens, light.position);
+            else if (option == "flicker")
+                ok = light.flicker = true;
+            else
+                ok = false;
+            if (!ok)
+                return false;
+        }
+        pointLights.push_back(light);
+        return true;
+    }
+
+    bool parseSpotLight(istringstream &tokens)
+    {
+        string option;
+        while (tokens >> option) {
+            bool ok;
+            if (option == "ambient")
+                ok = readVec3(tokens, torch.ambient);
+            else if (option == "attenuation")
+                ok = static_cast<bool>(tokens >> torch.constant >> torch.linear >> torch.quadratic);
+            else if (option == "cutoff")
+                ok = static_cast<bool>(tokens >> torch.cutOff >> torch.outerCutOff);
+            else
+                ok = false;
+            if (!ok)
+                return false;
+        }
+        return true;
+    }
+};
+#endif
@@ -0,0 +1,290 @@
+#ifndef SWARM_H
+#define SWARM_H
+
+#include <glm/glm.hpp>
+
+#include <learnopengl/thread_pool.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <vector>
+using namespace std;
+
+// Flocking fireflies simulated on the CPU, for behaviour that has to stay there (anything the game logic asks
+// about, unlike the GPU FireflyParticles). Each agent steers by separation, alignment and cohesion with the
+// neighbors within neighborRadius, is drawn to the nearest lamp, flees the camera and stays inside a box.
+//
+// Agents are stored as separate arrays per component (positions and velocities x, y, z) so the steering loop
+// streams through memory. Neighbors come from a spatial hash: agents are counting sorted into hashed grid cells of
+// neighborRadius, so a query looks at the 27 cells around an agent only. Hash collisions just add candidates that
+// the distance test rejects. The state is also copied out in bucket order, so an agent's candidates sit next to
+// each other in memory instead of all over arrays much larger than the cache. Steering and integration run as
+// parallelFor chunks on a ThreadPool, every agent reading the last step's state and writing only its own.
+class FireflySwarm
+{
+public:
+    float neighborRadius = 1.0f;
+    // neighbors an agent steers by at most, bounds the cost in crowded cells
+    unsigned int maxNeighbors = 16;
+    float separation = 1.5f;
+    float alignment = 0.6f;
+    float cohesion = 0.4f;
+    // lamps draw agents closer than lampRadius
+    float lampRadius = 6.0f;
+    float lampAttraction = 0.8f;
+    // the camera scares agents closer than this
+    float cameraRadius = 3.0f;
+    float cameraFear = 6.0f;
+    float minSpeed = 0.3f, maxSpeed = 2.0f;
+    // world size of an agent, for the instance matrices
+    float scale = 0.02f;
+
+    // of the last update()
+    double gridMilliseconds = 0.0;
+    double steerMilliseconds = 0.0;
+    double integrateMilliseconds = 0.0;
+
+    // count agents at random positions in the box center +- extent
+    void init(unsigned int count, glm::vec3 center, glm::vec3 extent, unsigned int seed = 5)
+    {
+        boundsCenter = center;
+        boundsExtent = extent;
+        mt19937 random(seed);
+        uniform_real_distribution<float> unit(-1.0f, 1.0f);
+        for (vector<float> *component : {&px, &py, &pz, &vx, &vy, &vz})
+            component->resize(count);
+        for (unsigned int i = 0; i < count; i++) {
+            px[i] = center.x + extent.x * unit(random);
+            py[i] = center.y + extent.y * unit(random);
+            pz[i] = center.z + extent.z * unit(random);
+            vx[i] = unit(random) * minSpeed;
+            vy[i] = unit(random) * minSpeed * 0.3f;
+            vz[i] = unit(random) * minSpeed;
+        }
+        nvx.resize(count);
+        nvy.resize(count);
+        nvz.resize(count);
+        transforms.assign(count, glm::mat4(1.0f));
+    }
+
+    unsigned int size() const
+    {
+        return px.size();
+    }
+
+    // advances every agent by deltaTime, on pool's workers if there is one, and refreshes transforms
+    void update(float deltaTime, glm::vec3 cameraPosition, const vector<glm::vec3> &lamps, ThreadPool *pool)
+    {
+        deltaTime = min(max(deltaTime, 0.0f), 0.1f);
+        auto run = [pool](size_t count, const function<void(size_t, size_t)> &body) {
+            if (pool)
+                pool->parallelFor(count, body);
+            else if (count > 0)
+                body(0, count);
+        };
+
+        auto start = chrono::steady_clock::now();
+        buildGrid(run);
+        auto gridDone = chrono::steady_clock::now();
+        run(size(), [&](size_t begin, size_t end) { steer(begin, end, deltaTime, cameraPosition, lamps); });
+        auto steerDone = chrono::steady_clock::now();
+        run(size(), [&](size_t begin, size_t end) { integrate(begin, end, deltaTime); });
+        auto integrateDone = chrono::steady_clock::now();
+
+        gridMilliseconds = chrono::duration<double, milli>(gridDone - start).count();
+        steerMilliseconds = chrono::duration<double, milli>(steerDone - gridDone).count();
+        integrateMilliseconds = chrono::duration<double, milli>(integrateDone - steerDone).count();
+    }
+
+    // world matrix of every agent, for an instance buffer
+    const vector<glm::mat4> &instanceTransforms() const
+    {
+        return transforms;
+    }
+
+private:
+    // positions and velocities
+    vector<float> px, py, pz;
+    vector<float> vx, vy, vz;
+    // velocities steering wrote, applied by integrate()
+    vector<float> nvx, nvy, nvz;
+    vector<glm::mat4> transforms;
+    glm::vec3 boundsCenter = glm::vec3(0.0f), boundsExtent = glm::vec3(1.0f);
+
+    // hashed cell of every agent, the first agent of every hash bucket in sorted and the agents sorted by bucket
+    vector<unsigned int> agentBucket;
+    vector<unsigned int> bucketStart;
+    vector<unsigned int> sorted;
+    // where the counting sort puts the next agent of every bucket
+    vector<unsigned int> bucketNext;
+    // positions and velocities in sorted order
+    vector<float> sx, sy, sz;
+    vector<float> svx, svy, svz;
+    unsigned int bucketMask = 0;
+
+    int cell(float coordinate) const
+    {
+        return (int) floor(coordinate / neighborRadius);
+    }
+
+    unsigned int bucket(int x, int y, int z) const
+    {
+        return ((unsigned int) x * 73856093u ^ (unsigned int) y * 19349663u ^ (unsigned int) z * 83492791u) & bucketMask;
+    }
+
+    template<typename Run>
+    void buildGrid(Run &run)
+    {
+        // about two buckets per agent keeps collisions rare
+        unsigned int buckets = 1;
+        while (buckets < size() * 2)
+            buckets *= 2;
+        bucketMask = buckets - 1;
+        agentBucket.resize(size());
+        run(size(), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++)
+                agentBucket[i] = bucket(cell(px[i]), cell(py[i]), cell(pz[i]));
+        });
+        // counting sort, bucketStart[b + 1] counts first, then holds where bucket b ends
+        bucketStart.assign(buckets + 1, 0);
+        for (unsigned int b : agentBucket)
+            bucketStart[b + 1]++;
+        for (unsigned int b = 0; b < buckets; b++)
+            bucketStart[b + 1] += bucketStart[b];
+        sorted.resize(size());
+        bucketNext.assign(bucketStart.begin(), bucketStart.end() - 1);
+        for (unsigned int i = 0; i < size(); i++)
+            sorted[bucketNext[agentBucket[i]]++] = i;
+        for (vector<float> *component : {&sx, &sy, &sz, &svx, &svy, &svz})
+            component->resize(size());
+        run(size(), [&](size_t begin, size_t end) {
+            for (size_t k = begin; k < end; k++) {
+                unsigned int i = sorted[k];
+                sx[k] = px[i];
+                sy[k] = py[i];
+                sz[k] = pz[i];
+                svx[k] = vx[i];
+                svy[k] = vy[i];
+                svz[k] = vz[i];
+            }
+        });
+    }
+
+    // agents sorted[begin] to sorted[end - 1]
+    void steer(size_t begin, size_t end, float deltaTime, glm::vec3 cameraPosition, const vector<glm::vec3> &lamps)
+    {
+        float radius2 = neighborRadius * neighborRadius;
+        float lampRadius2 = lampRadius * lampRadius;
+        for (size_t k = begin; k < end; k++) {
+            float x = sx[k], y = sy[k], z = sz[k];
+            float sepX = 0.0f, sepY = 0.0f, sepZ = 0.0f;
+            float velX = 0.0f, velY = 0.0f, velZ = 0.0f;
+            float posX = 0.0f, posY = 0.0f, posZ = 0.0f;
+            unsigned int neighbors = 0;
+
+            int cx = cell(x), cy = cell(y), cz = cell(z);
+            for (int dz = -1; dz <= 1 && neighbors < maxNeighbors; dz++)
+                for (int dy = -1; dy <= 1 && neighbors < maxNeighbors; dy++)
+                    for (int dx = -1; dx <= 1 && neighbors < maxNeighbors; dx++) {
+                        unsigned int b = bucket(cx + dx, cy + dy, cz + dz);
+                        for (unsigned int j = bucketStart[b]; j < bucketStart[b + 1] && neighbors < maxNeighbors; j++) {
+                            float ox = x - sx[j], oy = y - sy[j], oz = z - sz[j];
+                            float distance2 = ox * ox + oy * oy + oz * oz;
+                            if (j == k || distance2 >= radius2)
+                                continue;
+                            float inverse = 1.0f / max(distance2, 1e-4f);
+                            sepX += ox * inverse;
+                            sepY += oy * inverse;
+                            sepZ += oz * inverse;
+                            velX += svx[j];
+                            velY += svy[j];
+                            velZ += svz[j];
+                            posX += sx[j];
+                            posY += sy[j];
+                            posZ += sz[j];
+                            neighbors++;
+                        }
+                    }
+
+            float ax = 0.0f, ay = 0.0f, az = 0.0f;
+            if (neighbors > 0) {
+                float average = 1.0f / neighbors;
+                ax += sepX * separation + (velX * average - svx[k]) * alignment + (posX * average - x) * cohesion;
+                ay += sepY * separation + (velY * average - svy[k]) * alignment + (posY * average - y) * cohesion;
+                az += sepZ * separation + (velZ * average - svz[k]) * alignment + (posZ * average - z) * cohesion;
+            }
+
+            // towards the nearest lamp
+            float nearest2 = INFINITY;
+            glm::vec3 lamp;
+            for (const glm::vec3 &candidate : lamps) {
+                float distance2 = (candidate.x - x) * (candidate.x - x) + (candidate.y - y) * (candidate.y - y)
+                                + (candidate.z - z) * (candidate.z - z);
+                if (distance2 < nearest2) {
+                    nearest2 = distance2;
+                    lamp = candidate;
+                }
+            }
+            if (nearest2 > 0.0f && nearest2 < lampRadius2) {
+                float inverse = lampAttraction / sqrt(nearest2);
+                ax += (lamp.x - x) * inverse;
+                ay += (lamp.y - y) * inverse;
+                az += (lamp.z - z) * inverse;
+            }
+
+            // away from the camera, harder the closer it is
+            float cameraX = x - cameraPosition.x, cameraY = y - cameraPosition.y, cameraZ = z - cameraPosition.z;
+            float cameraDistance = sqrt(cameraX * cameraX + cameraY * cameraY + cameraZ * cameraZ);
+            if (cameraDistance < cameraRadius && cameraDistance > 0.0f) {
+                float push = cameraFear * (1.0f - cameraDistance / cameraRadius) / cameraDistance;
+                ax += cameraX * push;
+                ay += cameraY * push;
+                az += cameraZ * push;
+            }
+
+            // back into the box
+            ax += containment(x, boundsCenter.x, boundsExtent.x);
+            ay += containment(y, boundsCenter.y, boundsExtent.y);
+            az += containment(z, boundsCenter.z, boundsExtent.z);
+
+            float nx = svx[k] + ax * deltaTime, ny = svy[k] + ay * deltaTime, nz = svz[k] + az * deltaTime;
+            float speed = sqrt(nx * nx + ny * ny + nz * nz);
+            float clamped = min(max(speed, minSpeed), maxSpeed);
+            if (speed > 0.0f) {
+                nx *= clamped / speed;
+                ny *= clamped / speed;
+                nz *= clamped / speed;
+            }
+            unsigned int i = sorted[k];
+            nvx[i] = nx;
+            nvy[i] = ny;
+            nvz[i] = nz;
+        }
+    }
+
+    static float containment(float position, float center, float extent)
+    {
+        float outside = fabs(position - center) - extent;
+        return outside > 0.0f ? (position > center ? -outside : outside) * 4.0f : 0.0f;
+    }
+
+    void integrate(size_t begin, size_t end, float deltaTime)
+    {
+        for (size_t i = begin; i < end; i++) {
+            vx[i] = nvx[i];
+            vy[i] = nvy[i];
+            vz[i] = nvz[i];
+            px[i] += vx[i] * deltaTime;
+            py[i] += vy[i] * deltaTime;
+            pz[i] += vz[i] * deltaTime;
+            glm::mat4 &transform = transforms[i];
+            transform[0] = glm::vec4(scale, 0.0f, 0.0f, 0.0f);
+            transform[1] = glm::vec4(0.0f, scale, 0.0f, 0.0f);
+            transform[2] = glm::vec4(0.0f, 0.0f, scale, 0.0f);
+            transform[3] = glm::vec4(px[i], py[i], pz[i], 1.0f);
+        }
+    }
+};
+#endif
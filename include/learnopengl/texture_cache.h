@@ -0,0 +1,167 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include <glad/glad.h>
+#include <stb_image.h>
+
+#include <learnopengl/thread_pool.h>
+
+#include <climits>
+#include <cstdlib>
+#include <future>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+using namespace std;
+
+// decoded pixels of a texture that hasn't been uploaded to the GPU yet
+struct TextureData {
+    int width = 0;
+    int height = 0;
+    int nrComponents = 0;
+    unsigned char *pixels = nullptr;
+};
+
+TextureData DecodeTexture(const string &filename);
+unsigned int UploadTexture(TextureData &texture, const string &filename);
+
+// Process-wide cache of model textures, keyed by canonical absolute path, so a texture shared between models
+// (e.g. the two StonePlatform files) is decoded and uploaded once.
+// Loading is split in three steps: request() registers a file (any thread), decodePending() decodes all new files
+// in parallel on worker threads and uploadPending() creates the GL textures on the context thread.
+class TextureCache
+{
+public:
+    static TextureCache &instance()
+    {
+        static TextureCache cache;
+        return cache;
+    }
+
+    // registers a texture file and returns its canonical path, which is the key for id()
+    string request(const string &filename)
+    {
+        string key = canonicalPath(filename);
+        std::lock_guard<std::mutex> lock(mutex);
+        entries.emplace(key, Entry());
+        return key;
+    }
+
+    // decodes every requested texture that hasn't been decoded yet, spread over the pool's workers
+    void decodePending(ThreadPool &pool)
+    {
+        vector<future<void>> decodes;
+        for (Entry *entry : takeUndecoded())
+            decodes.push_back(pool.enqueue([entry] { entry->data = DecodeTexture(entry->filename); }));
+        pool.wait();
+        for (future<void> &decode : decodes)
+            decode.get();
+    }
+
+    // creates GL textures for all requested textures that don't have one yet, has to run on the GL context thread.
+    // anything that wasn't decoded by decodePending() is decoded here, on the calling thread.
+    void uploadPending()
+    {
+        for (Entry *entry : takeUndecoded())
+            entry->data = DecodeTexture(entry->filename);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto &it : entries) {
+            Entry &entry = it.second;
+            if (entry.id == 0)
+                entry.id = UploadTexture(entry.data, entry.filename);
+        }
+    }
+
+    // GL texture of a requested path (as returned by request()), 0 while it's not uploaded
+    unsigned int id(const string &key) const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = entries.find(key);
+        return it != entries.end() ? it->second.id : 0;
+    }
+
+private:
+    struct Entry {
+        string filename;
+        bool decodeStarted = false;
+        TextureData data;
+        unsigned int id = 0;
+    };
+
+    // element references of an unordered_map stay valid on insert, so workers can fill entries without the lock
+    unordered_map<string, Entry> entries;
+    mutable std::mutex mutex;
+
+    TextureCache() = default;
+
+    vector<Entry *> takeUndecoded()
+    {
+        vector<Entry *> undecoded;
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto &it : entries) {
+            Entry &entry = it.second;
+            if (!entry.decodeStarted) {
+                entry.decodeStarted = true;
+                entry.filename = it.first;
+                undecoded.push_back(&entry);
+            }
+        }
+        return undecoded;
+    }
+
+    static string canonicalPath(const string &filename)
+    {
+        char resolved[PATH_MAX];
+        if (realpath(filename.c_str(), resolved))
+            return resolved;
+        return filename; // missing file, keep the name for the error message
+    }
+};
+
+// reads and decodes an image file, safe to call from worker threads
+TextureData DecodeTexture(const string &filename)
+{
+    TextureData texture;
+    texture.pixels = stbi_load(filename.c_str(), &texture.width, &texture.height, &texture.nrComponents, 0);
+    return texture;
+}
+
+// creates a GL texture from decoded pixels and frees them
+unsigned int UploadTexture(TextureData &texture, const string &filename)
+{
+    unsigned int textureID;
+    glGenTextures(1, &textureID);
+
+    if (texture.pixels)
+    {
+        GLenum format;
+        if (texture.nrComponents == 1)
+            format = GL_RED;
+        else if (texture.nrComponents == 3)
+            format = GL_RGB;
+        else if (texture.nrComponents == 4)
+            format = GL_RGBA;
+
+        glBindTexture(GL_TEXTURE_2D, textureID);
+        glTexImage2D(GL_TEXTURE_2D, 0, format, texture.width, texture.height, 0, format, GL_UNSIGNED_BYTE, texture.pixels);
+        glGenerateMipmap(GL_TEXTURE_2D);
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        stbi_image_free(texture.pixels);
+        texture.pixels = nullptr;
+    }
+    else
+    {
+        std::cout << "Texture failed to load at path: " << filename << std::endl;
+    }
+
+    return textureID;
+}
+#endif
@@ -0,0 +1,116 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// Fixed size pool of worker threads for CPU side work (model import, texture decoding, ...).
+// Workers never touch the GL context, anything that needs GL has to be handed back to the context thread.
+class ThreadPool
+{
+public:
+    // creates threadCount workers, 0 means one per hardware thread
+    explicit ThreadPool(unsigned int threadCount = 0)
+    {
+        if (threadCount == 0)
+            threadCount = std::max(1u, std::thread::hardware_concurrency());
+        for (unsigned int i = 0; i < threadCount; i++)
+            workers.emplace_back([this] { workerLoop(); });
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        taskAvailable.notify_all();
+        for (std::thread &worker : workers)
+            worker.join();
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    unsigned int size() const
+    {
+        return workers.size();
+    }
+
+    // queues a task, the returned future becomes ready when it has run (and rethrows its exception, if any)
+    std::future<void> enqueue(std::function<void()> task)
+    {
+        auto packaged = std::make_shared<std::packaged_task<void()>>(std::move(task));
+        std::future<void> result = packaged->get_future();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.push([packaged] { (*packaged)(); });
+            pending++;
+        }
+        taskAvailable.notify_one();
+        return result;
+    }
+
+    // blocks until every queued task has finished
+    void wait()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        allDone.wait(lock, [this] { return pending == 0; });
+    }
+
+    // runs body(begin, end) over [0, count) split into a few chunks per worker and blocks until all of them are done.
+    // waits on its own chunks only, other queued tasks keep running
+    void parallelFor(size_t count, const std::function<void(size_t, size_t)> &body)
+    {
+        size_t chunks = std::min(count, (size_t) size() * 4);
+        if (chunks <= 1) {
+            if (count > 0)
+                body(0, count);
+            return;
+        }
+        std::vector<std::future<void>> done;
+        for (size_t chunk = 0; chunk < chunks; chunk++) {
+            size_t begin = count * chunk / chunks, end = count * (chunk + 1) / chunks;
+            done.push_back(enqueue([&body, begin, end] { body(begin, end); }));
+        }
+        for (std::future<void> &chunk : done)
+            chunk.get();
+    }
+
+private:
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable taskAvailable;
+    std::condition_variable allDone;
+    unsigned int pending = 0;
+    bool stopping = false;
+
+    void workerLoop()
+    {
+        while (true) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                taskAvailable.wait(lock, [this] { return stopping || !tasks.empty(); });
+                if (stopping && tasks.empty())
+                    return;
+                task = std::move(tasks.front());
+                tasks.pop();
+            }
+            task();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                pending--;
+            }
+            allDone.notify_all();
+        }
+    }
+};
+#endif
@@ -0,0 +1,158 @@
+#ifndef VERTEX_FORMAT_H
+#define VERTEX_FORMAT_H
+
+#include <glad/glad.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+using namespace std;
+
+struct Vertex {
+    // position
+    glm::vec3 Position;
+    // normal
+    glm::vec3 Normal;
+    // texCoords
+    glm::vec2 TexCoords;
+    // tangent
+    glm::vec3 Tangent;
+    // bitangent
+    glm::vec3 Bitangent;
+};
+
+// vertex attributes of the mesh shaders, bit i is attribute location i
+enum VertexAttribute {
+    VERTEX_POSITION  = 1 << 0,
+    VERTEX_NORMAL    = 1 << 1,
+    VERTEX_TEXCOORDS = 1 << 2,
+    VERTEX_TANGENT   = 1 << 3,
+    VERTEX_BITANGENT = 1 << 4,
+    VERTEX_ATTRIBUTES_ALL = (1 << 5) - 1
+};
+
+const unsigned int VERTEX_ATTRIBUTE_COUNT = 5;
+
+// the mesh vertex attributes (locations 0-4) a linked program actually reads, attributes the compiler
+// optimized away don't count
+inline unsigned int activeVertexAttributes(GLuint program)
+{
+    unsigned int attributes = 0;
+    GLint count = 0, maxLength = 0;
+    glGetProgramiv(program, GL_ACTIVE_ATTRIBUTES, &count);
+    glGetProgramiv(program, GL_ACTIVE_ATTRIBUTE_MAX_LENGTH, &maxLength);
+    vector<GLchar> name(maxLength + 1);
+    for (GLint i = 0; i < count; i++) {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type;
+        glGetActiveAttrib(program, (GLuint) i, name.size(), &length, &size, &type, name.data());
+        GLint location = glGetAttribLocation(program, name.data());
+        if (location >= 0 && location < (GLint) VERTEX_ATTRIBUTE_COUNT)
+            attributes |= 1u << location;
+    }
+    return attributes;
+}
+
+// Layout of the vertex buffer of a mesh. The full layout is the Vertex struct as is (56 bytes). Packed layouts only
+// keep the attributes in use and shrink them: normals and tangents become GL_INT_2_10_10_10_REV, texture coordinates
+// half floats, positions stay 32-bit floats. A packed layout has no bitangent, the tangent's w holds its sign
+// instead and shaders rebuild it as cross(normal, tangent.xyz) * tangent.w.
+struct VertexLayout {
+    unsigned int attributes;
+    bool packed;
+    unsigned int stride;
+    // byte offset of every attribute in a vertex, for the attributes in use
+    unsigned int offsets[VERTEX_ATTRIBUTE_COUNT];
+
+    static VertexLayout full()
+    {
+        VertexLayout layout;
+        layout.attributes = VERTEX_ATTRIBUTES_ALL;
+        layout.packed = false;
+        layout.stride = sizeof(Vertex);
+        layout.offsets[0] = offsetof(Vertex, Position);
+        layout.offsets[1] = offsetof(Vertex, Normal);
+        layout.offsets[2] = offsetof(Vertex, TexCoords);
+        layout.offsets[3] = offsetof(Vertex, Tangent);
+        layout.offsets[4] = offsetof(Vertex, Bitangent);
+        return layout;
+    }
+
+    // smallest layout holding the given attributes
+    static VertexLayout packedFor(unsigned int attributes)
+    {
+        VertexLayout layout;
+        layout.attributes = attributes | VERTEX_POSITION;
+        if (layout.attributes & VERTEX_BITANGENT)
+            layout.attributes = (layout.attributes & ~VERTEX_BITANGENT) | VERTEX_TANGENT;
+        layout.packed = true;
+        layout.stride = 0;
+        static const unsigned int sizes[VERTEX_ATTRIBUTE_COUNT] = {3 * sizeof(float), 4, 4, 4, 0};
+        for (unsigned int i = 0; i < VERTEX_ATTRIBUTE_COUNT; i++) {
+            layout.offsets[i] = layout.stride;
+            if (layout.attributes & (1u << i))
+                layout.stride += sizes[i];
+        }
+        return layout;
+    }
+
+    bool isFull() const
+    {
+        return !packed && attributes == VERTEX_ATTRIBUTES_ALL;
+    }
+
+    // converts vertices to this layout
+    void pack(const vector<Vertex> &vertices, vector<unsigned char> &data) const
+    {
+        data.resize(vertices.size() * stride);
+        if (isFull()) {
+            if (!vertices.empty())
+                memcpy(data.data(), vertices.data(), data.size());
+            return;
+        }
+        for (size_t v = 0; v < vertices.size(); v++) {
+            const Vertex &vertex = vertices[v];
+            unsigned char *out = data.data() + v * stride;
+            memcpy(out + offsets[0], &vertex.Position, sizeof(glm::vec3));
+            if (attributes & VERTEX_NORMAL)
+                store(out + offsets[1], glm::packSnorm3x10_1x2(glm::vec4(vertex.Normal, 0.0f)));
+            if (attributes & VERTEX_TEXCOORDS)
+                store(out + offsets[2], glm::packHalf2x16(vertex.TexCoords));
+            if (attributes & VERTEX_TANGENT) {
+                float handedness = glm::dot(glm::cross(vertex.Normal, vertex.Tangent), vertex.Bitangent) < 0.0f ? -1.0f : 1.0f;
+                store(out + offsets[3], glm::packSnorm3x10_1x2(glm::vec4(vertex.Tangent, handedness)));
+            }
+        }
+    }
+
+    // sets the attribute pointers of the bound VAO for the bound GL_ARRAY_BUFFER
+    void setAttributePointers() const
+    {
+        for (unsigned int i = 0; i < VERTEX_ATTRIBUTE_COUNT; i++) {
+            if (!(attributes & (1u << i)))
+                continue;
+            glEnableVertexAttribArray(i);
+            void *offset = (void*)(size_t) offsets[i];
+            if (!packed)
+                glVertexAttribPointer(i, i == 2 ? 2 : 3, GL_FLOAT, GL_FALSE, stride, offset);
+            else if (i == 0)
+                glVertexAttribPointer(i, 3, GL_FLOAT, GL_FALSE, stride, offset);
+            else if (i == 2)
+                glVertexAttribPointer(i, 2, GL_HALF_FLOAT, GL_FALSE, stride, offset);
+            else
+                glVertexAttribPointer(i, 4, GL_INT_2_10_10_10_REV, GL_TRUE, stride, offset);
+        }
+    }
+
+private:
+    static void store(unsigned char *out, uint32_t value)
+    {
+        memcpy(out, &value, sizeof(value));
+    }
+};
+#endif
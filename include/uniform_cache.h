@@ -0,0 +1,63 @@
+#ifndef PROJECT_BASE_UNIFORM_CACHE_H
+#define PROJECT_BASE_UNIFORM_CACHE_H
+
+#include <glad/glad.h>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Location of a uniform together with the type it holds. Look it up once (Shader::uniform<T>("name")),
+// then Shader::set(handle, value) is a single glUniform* call with no string work or hashing.
+template<typename T>
+struct Uniform {
+    GLint location = -1;
+};
+
+// Name -> location table of every active uniform of a linked program, filled through program introspection.
+// Arrays are reachable both by their base name ("weight") and per element ("weight[3]").
+class UniformLocationCache {
+public:
+    void build(GLuint program)
+    {
+        locations.clear();
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::vector<GLchar> buffer(maxLength + 1);
+        for (GLint i = 0; i < count; i++) {
+            GLsizei length = 0;
+            GLint size = 0;
+            GLenum type;
+            glGetActiveUniform(program, (GLuint) i, buffer.size(), &length, &size, &type, buffer.data());
+            std::string name(buffer.data(), length);
+            GLint location = glGetUniformLocation(program, name.c_str());
+            if (location < 0)
+                continue; // member of a uniform block
+            locations[name] = location;
+
+            // "name[0]" for arrays of basic types, also register the base name and the remaining elements
+            const std::string suffix = "[0]";
+            if (name.size() > suffix.size() && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0) {
+                std::string base = name.substr(0, name.size() - suffix.size());
+                locations[base] = location;
+                for (GLint element = 1; element < size; element++) {
+                    std::string elementName = base + '[' + std::to_string(element) + ']';
+                    locations[elementName] = glGetUniformLocation(program, elementName.c_str());
+                }
+            }
+        }
+    }
+
+    // -1 for names that aren't active uniforms, which glUniform* silently ignores
+    GLint find(const std::string &name) const
+    {
+        auto it = locations.find(name);
+        return it != locations.end() ? it->second : -1;
+    }
+
+private:
+    std::unordered_map<std::string, GLint> locations;
+};
+
+#endif //PROJECT_BASE_UNIFORM_CACHE_H
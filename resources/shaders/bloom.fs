@@ -6,6 +6,8 @@ in vec2 TexCoords;
 uniform sampler2D scene;
 uniform sampler2D bloomBlur;
 uniform bool bloom;
+// scales bloomBlur, the mip chain bloom sums several levels
+uniform float bloomStrength = 1.0;
 uniform float exposure;
 
 void main() {
@@ -13,7 +15,7 @@ void main() {
     vec3 hdrColor = texture(scene, TexCoords).rgb;
     vec3 bloomColor = texture(bloomBlur, TexCoords).rgb;
     if(bloom)
-        hdrColor += bloomColor;
+        hdrColor += bloomColor * bloomStrength;
     vec3 result = vec3(1.0) - exp(-hdrColor * exposure);
     //result = pow(result, vec3(1.0 / gamma));
     FragColor = vec4(result, 1.0);
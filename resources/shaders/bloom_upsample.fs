@@ -0,0 +1,20 @@
+#version 330 core
+out vec4 FragColor;
+
+in vec2 TexCoords;
+
+// the level below, half the size of this one
+uniform sampler2D source;
+// tent radius in texture coordinates
+uniform vec2 filterRadius;
+
+// 3x3 tent, added onto this level's own downsample by blending
+void main() {
+    vec2 r = filterRadius;
+    vec3 result = texture(source, TexCoords).rgb * 4.0;
+    result += (texture(source, TexCoords + vec2(-r.x, 0.0)).rgb + texture(source, TexCoords + vec2(r.x, 0.0)).rgb
+             + texture(source, TexCoords + vec2(0.0, -r.y)).rgb + texture(source, TexCoords + vec2(0.0, r.y)).rgb) * 2.0;
+    result += texture(source, TexCoords + vec2(-r.x, -r.y)).rgb + texture(source, TexCoords + vec2(r.x, -r.y)).rgb
+            + texture(source, TexCoords + vec2(-r.x, r.y)).rgb + texture(source, TexCoords + vec2(r.x, r.y)).rgb;
+    FragColor = vec4(result / 16.0, 1.0);
+}
@@ -0,0 +1,50 @@
+#version 330 core
+// light pass of the deferred path (see include/learnopengl/deferred.h): lights the G-buffer pixels the scissor
+// rectangle lets through with the light functions model.fs uses too
+layout (location = 0) out vec4 FragColor;
+layout (location = 1) out vec4 BrightColor;
+
+#include "lighting.glsl"
+
+uniform sampler2D gPosition;
+uniform sampler2D gNormal;
+uniform sampler2D gAlbedo;
+// -1 for the directional light and the torch (and the clustered point lights), otherwise the point light to add
+uniform int pointLight;
+
+float shininess;
+
+float materialShininess() {
+    return shininess;
+}
+
+void main() {
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    vec4 position = texelFetch(gPosition, pixel, 0);
+    if (position.w == 0.0)
+        discard;
+    vec4 normal = texelFetch(gNormal, pixel, 0);
+    vec3 tex = texelFetch(gAlbedo, pixel, 0).rgb;
+    vec3 fragPos = position.xyz;
+    vec3 norm = normal.xyz;
+    shininess = normal.w;
+    vec3 viewDir = normalize(viewPos - fragPos);
+
+    vec3 result = vec3(0.0);
+    if (pointLight < 0) {
+        result += CalculateDirLight(dirLight, norm, viewDir, tex);
+        if (bTorch == true)
+            result += CalculateSpotLight(torch, norm, fragPos, viewDir, tex);
+        if (clustered) {
+            uvec2 range = clusterRange(fragPos);
+            for (uint i = 0u; i < range.y; i++)
+                result += CalculatePointLight(clusterLight(texelFetch(clusterIndices, int(range.x + i)).x), norm, fragPos, viewDir, tex);
+        }
+    } else {
+        result += CalculatePointLight(pointLights[pointLight], norm, fragPos, viewDir, tex);
+    }
+
+    FragColor = vec4(result, 1.0);
+    // lit scene geometry doesn't bloom, only the moon and fireflies write bright color
+    BrightColor = vec4(0.0);
+}
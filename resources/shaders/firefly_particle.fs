@@ -0,0 +1,18 @@
+#version 330 core
+layout (location = 0) out vec4 FragColor;
+layout (location = 1) out vec4 BrightColor;
+
+in float Brightness;
+
+uniform vec3 color;
+
+void main() {
+    // round sprite, brightest in the middle
+    float distance = length(gl_PointCoord - vec2(0.5)) * 2.0;
+    if (distance > 1.0)
+        discard;
+    float glow = (1.0 - distance) * (1.0 - distance);
+    // drawn additively, the bright part goes straight to bloom
+    FragColor = vec4(color * glow * Brightness * 5.0, 1.0);
+    BrightColor = FragColor;
+}
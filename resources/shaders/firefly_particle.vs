@@ -0,0 +1,23 @@
+#version 330 core
+layout (location = 0) in vec4 aPosition; // xyz, flicker phase
+layout (location = 1) in vec4 aVelocity; // xyz, wander speed
+
+out float Brightness;
+
+layout (std140) uniform Camera {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+};
+
+uniform float time;
+// sprite size in pixels at distance one
+uniform float pointScale;
+
+void main() {
+    vec4 viewPosition = view * vec4(aPosition.xyz, 1.0);
+    gl_Position = projection * viewPosition;
+    gl_PointSize = max(pointScale / max(-viewPosition.z, 0.1), 1.0);
+    // slow pulses, each firefly out of step with the rest
+    Brightness = pow(0.5 + 0.5 * sin(time * (1.0 + aVelocity.w) + aPosition.w), 3.0);
+}
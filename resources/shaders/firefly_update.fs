@@ -0,0 +1,7 @@
+#version 330 core
+// never runs, firefly_update.vs draws with rasterization off
+out vec4 FragColor;
+
+void main() {
+    FragColor = vec4(0.0);
+}
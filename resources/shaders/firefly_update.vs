@@ -0,0 +1,33 @@
+#version 330 core
+// one particle, read from the current state buffer
+layout (location = 0) in vec4 aPosition; // xyz, flicker phase
+layout (location = 1) in vec4 aVelocity; // xyz, wander speed
+
+// written to the other state buffer by transform feedback
+out vec4 outPosition;
+out vec4 outVelocity;
+
+uniform float time;
+uniform float deltaTime;
+// the box the fireflies stay in
+uniform vec3 boundsCenter;
+uniform vec3 boundsExtent;
+
+void main() {
+    vec3 position = aPosition.xyz;
+    float phase = aPosition.w;
+    float speed = aVelocity.w;
+
+    // every firefly wanders along its own slowly turning direction, mostly level
+    float t = time * speed;
+    vec3 wander = vec3(sin(t * 0.7 + phase * 3.1) + sin(t * 1.9 + phase),
+                       0.4 * sin(t * 0.5 + phase * 5.3),
+                       cos(t * 0.6 + phase * 7.7) + cos(t * 1.7 + phase * 2.3));
+    // and is pulled back when it leaves the box
+    vec3 outside = max(abs(position - boundsCenter) - boundsExtent, 0.0) * sign(boundsCenter - position);
+    vec3 desired = wander * speed + outside * 2.0;
+
+    vec3 velocity = mix(aVelocity.xyz, desired, 1.0 - exp(-2.0 * deltaTime));
+    outPosition = vec4(position + velocity * deltaTime, phase);
+    outVelocity = vec4(velocity, speed);
+}
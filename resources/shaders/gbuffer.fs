@@ -0,0 +1,34 @@
+#version 330 core
+// G-buffer of the deferred path (see include/learnopengl/deferred.h), drawn with model.vs
+layout (location = 0) out vec4 gPosition;
+layout (location = 1) out vec4 gNormal;
+layout (location = 2) out vec4 gAlbedo;
+
+struct Material {
+    sampler2D texture_diffuse1;
+    sampler2D texture_specular1;
+
+    float shininess;
+};
+
+in vec2 TexCoords;
+in vec3 Normal;
+in vec3 FragPos;
+// material of indirect draws, from their record
+flat in float Shininess;
+uniform bool indirect;
+
+uniform sampler2D texture_diffuse1;
+uniform Material material;
+
+void main() {
+    vec4 tex = vec4(texture(texture_diffuse1, TexCoords));
+
+    if (tex.a < 0.5)
+        discard;
+
+    // w = 1 marks the pixel as covered, the light pass skips the rest
+    gPosition = vec4(FragPos, 1.0);
+    gNormal = vec4(normalize(Normal), indirect ? Shininess : material.shininess);
+    gAlbedo = vec4(tex.rgb, 1.0);
+}
@@ -0,0 +1,124 @@
+// lighting shared by model.fs and deferred_light.fs, pasted in by Shader where they #include it
+
+#define MAX_POINT_LIGHTS (16)
+
+// light structs are members of the std140 Lights block, scalars fill the padding after each vec3
+struct DirLight {
+    vec3 direction;
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+};
+
+struct PointLight {
+    vec3 position;
+    float constant;
+    vec3 ambient;
+    float linear;
+    vec3 diffuse;
+    float quadratic;
+    vec3 specular;
+};
+
+struct SpotLight {
+    vec3 position;
+    float constant;
+    vec3 ambient;
+    float linear;
+    vec3 diffuse;
+    float quadratic;
+    vec3 specular;
+    float cutOff;
+    vec3 direction;
+    float outerCutOff;
+};
+
+layout (std140) uniform Camera {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+};
+
+layout (std140) uniform Lights {
+    DirLight dirLight;
+    SpotLight torch;
+    PointLight pointLights[MAX_POINT_LIGHTS];
+    int nrPointLights;
+    bool bTorch;
+};
+
+// clustered point lights (see include/learnopengl/light_clusters.h), used instead of pointLights when clustered is set
+uniform bool clustered;
+uniform samplerBuffer clusterLights;
+uniform usamplerBuffer clusterRanges;
+uniform usamplerBuffer clusterIndices;
+uniform ivec3 clusterGrid;
+uniform vec2 clusterTileSize;
+uniform float clusterNear;
+uniform float clusterSliceScale;
+
+// (offset, count) of the lights of the cluster the fragment at fragPos falls in
+uvec2 clusterRange(vec3 fragPos) {
+    ivec2 tile = min(ivec2(gl_FragCoord.xy / clusterTileSize), clusterGrid.xy - 1);
+    float depth = -(view * vec4(fragPos, 1.0)).z;
+    int slice = depth <= clusterNear ? 0 : min(int(log(depth / clusterNear) * clusterSliceScale), clusterGrid.z - 1);
+    return texelFetch(clusterRanges, (slice * clusterGrid.y + tile.y) * clusterGrid.x + tile.x).xy;
+}
+
+PointLight clusterLight(uint index) {
+    int texel = int(index) * 4;
+    vec4 a = texelFetch(clusterLights, texel);
+    vec4 b = texelFetch(clusterLights, texel + 1);
+    vec4 c = texelFetch(clusterLights, texel + 2);
+    vec4 d = texelFetch(clusterLights, texel + 3);
+    return PointLight(a.xyz, a.w, b.xyz, b.w, c.xyz, c.w, d.xyz);
+}
+
+// specular exponent of the fragment, defined by the including shader
+float materialShininess();
+
+vec3 CalculateDirLight(DirLight light, vec3 normal, vec3 viewDir, vec3 tex) {
+    vec3 lightDir = normalize(-light.direction);
+    vec3 halfwayDir = normalize(-light.direction + viewDir);
+    float diff = max(dot(normal, lightDir), 0.0);
+    float spec = pow(max(dot(normal, halfwayDir), 0.0), materialShininess());
+    vec3 ambient = light.ambient * tex;
+    vec3 diffuse = light.diffuse * diff * tex;
+    vec3 specular = light.specular * spec * tex;
+    return (ambient + diffuse + specular);
+}
+
+vec3 CalculatePointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 tex) {
+    vec3 lightDir = normalize(light.position - fragPos);
+    vec3 halfwayDir = normalize(light.position + viewDir);
+    float diff = max(dot(normal, lightDir), 0.0);
+    float spec = pow(max(dot(normal, halfwayDir), 0.0), materialShininess());
+    float distance = length(light.position - fragPos);
+    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance*distance));
+    vec3 ambient = light.ambient * tex;
+    vec3 diffuse = light.diffuse * diff * tex;
+    vec3 specular = light.specular * spec * tex;
+    ambient *= attenuation;
+    diffuse *= attenuation;
+    specular *= attenuation;
+    return (ambient + diffuse + specular);
+}
+
+vec3 CalculateSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir, vec3 tex) {
+    vec3 lightDir = normalize(light.position - fragPos);
+    vec3 halfwayDir = normalize(light.position + viewDir);
+    float diff = max(dot(normal, lightDir), 0.0);
+    float spec = pow(max(dot(normal, halfwayDir), 0.0), materialShininess());
+    float distance = length(light.position - fragPos);
+    float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance*distance));
+    float theta = dot(lightDir, normalize(-light.direction));
+    float epsilon = light.cutOff - light.outerCutOff;
+    float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
+    vec3 ambient = light.ambient * tex;
+    vec3 diffuse = light.diffuse * diff * tex;
+    vec3 specular = light.specular * spec * tex;
+    ambient *= attenuation * intensity;
+    diffuse *= attenuation * intensity;
+    specular *= attenuation * intensity;
+    return (ambient + diffuse + specular);
+}
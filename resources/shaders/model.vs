@@ -2,18 +2,39 @@
 layout (location = 0) in vec3 aPos;
 layout (location = 1) in vec3 aNormal;
 layout (location = 2) in vec2 aTexCoords;
+layout (location = 5) in mat4 aInstanceModel;
+layout (location = 9) in int aDrawID;
 
 out vec2 TexCoords;
 out vec3 Normal;
 out vec3 FragPos;
+flat out float Shininess;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// instanced draws take the model matrix from aInstanceModel instead of the model uniform
+uniform bool instanced;
+// indirect draws read the model matrix and material from their record in drawData instead (see IndirectDraws)
+uniform bool indirect;
+uniform int drawOffset;
+uniform samplerBuffer drawData;
+
+layout (std140) uniform Camera {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPos;
+};
 
 void main() {
-    FragPos = (model * vec4(aPos, 1.0)).xyz;
+    Shininess = 0.0;
+    mat4 modelMatrix = instanced ? aInstanceModel : model;
+    if (indirect) {
+        int record = (aDrawID + drawOffset) * 5;
+        modelMatrix = mat4(texelFetch(drawData, record), texelFetch(drawData, record + 1),
+                           texelFetch(drawData, record + 2), texelFetch(drawData, record + 3));
+        Shininess = texelFetch(drawData, record + 4).x;
+    }
+    FragPos = (modelMatrix * vec4(aPos, 1.0)).xyz;
     TexCoords = aTexCoords;
     Normal = aNormal;
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    gl_Position = projection * view * modelMatrix * vec4(aPos, 1.0);
 }
\ No newline at end of file
@@ -13,8 +13,30 @@
 #include <learnopengl/shader.h>
 #include <learnopengl/camera.h>
 #include <learnopengl/model.h>
+#include <learnopengl/frame_constants.h>
+#include <learnopengl/scene.h>
+#include <learnopengl/render_queue.h>
+#include <learnopengl/culling.h>
+#include <learnopengl/profiler.h>
+#include <learnopengl/camera_path.h>
+#include <learnopengl/benchmark.h>
+#include <learnopengl/golden_image.h>
+#include <learnopengl/deferred.h>
+#include <learnopengl/bloom.h>
+#include <learnopengl/light_clusters.h>
+#include <learnopengl/particles.h>
+#include <learnopengl/swarm.h>
+#include <learnopengl/thread_pool.h>
 
 #include <iostream>
+#include <fstream>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <future>
+#include <memory>
+#include <random>
+#include <stdexcept>
 
 void framebuffer_size_callback(GLFWwindow *window, int width, int height);
 
@@ -29,6 +51,10 @@ void key_callback(GLFWwindow *window, int key, int scancode, int action, int mod
 unsigned int loadTexture(char const * path);
 unsigned int loadCubemap(vector<std::string> faces);
 void renderQuad();
+void benchmarkModelDraw(Shader &shader, const std::vector<std::pair<Model *, std::string>> &models, unsigned int iterations);
+void benchmarkSwarm();
+void benchmarkBloom(Shader &blurShader, Shader &downsampleShader, Shader &upsampleShader);
+bool parseCount(const char *option, const std::string &text, unsigned int &count);
 
 // settings
 const unsigned int SCR_WIDTH = 1500;
@@ -55,6 +81,57 @@ bool hdrKeyPressed = true;
 float exposure = 0.5f;
 bool bloodMoon = false;
 
+// startup
+bool serialModelLoad = false;
+bool benchmarkDraw = false;
+bool benchmarkBloomPaths = false;
+unsigned int stressCount = 0;
+unsigned int swarmLights = 0;
+unsigned int particleCount = 20000;
+unsigned int swarmCount = 0;
+bool swarmBenchmark = false;
+std::string sceneFile = "resources/scenes/blood_moon.scene";
+bool packedVertices = true;
+std::string profileCsvFile;
+// --benchmark: hidden window, scripted camera, fixed time step, JSON report at the end
+bool benchmark = false;
+unsigned int benchmarkFrames = 600;
+std::string benchmarkOutput;
+// --light-sweep: one benchmark run per point light count
+std::vector<unsigned int> lightSweep;
+const unsigned int BENCHMARK_WARMUP_FRAMES = 60;
+const float BENCHMARK_DELTA_TIME = 1.0f / 60.0f;
+// --golden DIR: render the poses of DIR/poses.txt in a hidden window and compare them to the reference images there
+std::string goldenDirectory;
+bool goldenUpdate = false;
+// frames rendered per pose: warm-up, timed, then the captured one
+const unsigned int GOLDEN_WARMUP_FRAMES = 3;
+const unsigned int GOLDEN_TIMED_FRAMES = 10;
+const unsigned int GOLDEN_FRAMES_PER_POSE = GOLDEN_WARMUP_FRAMES + GOLDEN_TIMED_FRAMES + 1;
+// perceived color difference a pixel may have, and the fraction of pixels that may exceed it
+const float GOLDEN_THRESHOLD = 0.1f;
+const float GOLDEN_MAX_DIFFERENT_PIXELS = 0.001f;
+
+// draws of the frame, sorted by render state
+RenderQueue renderQueue;
+// mesh instances of the frame that are in view
+SceneCuller sceneCuller;
+// per-instance records and multi-draw submission of the scene meshes
+IndirectDraws indirectDraws;
+// CPU and GPU time of the passes of a frame
+Profiler profiler;
+// G-buffer and light pass of the lit scene meshes, when deferred shading is on
+DeferredRenderer deferredRenderer;
+// point lights binned into view clusters, for more of them than the Lights block holds
+LightClusters lightClusters;
+// fireflies simulated and drawn on the GPU
+FireflyParticles fireflyParticles;
+// fireflies flocking on the CPU
+FireflySwarm fireflySwarm;
+bool swarmEnabled = true;
+// blur of the bright color buffer
+BloomRenderer bloomRenderer;
+
 struct ProgramState {
     glm::vec3 clearColor = glm::vec3(0);
     bool ImGuiEnabled = false;
@@ -102,7 +179,80 @@ ProgramState *programState;
 
 void DrawImGui(ProgramState *programState);
 
-int main() {
+int main(int argc, char **argv) {
+    // command line options
+    // --------------------
+    bool badOption = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--no-mesh-cache") == 0)
+            MeshCache::enabled = false;
+        else if (strcmp(argv[i], "--serial-load") == 0)
+            serialModelLoad = true;
+        else if (strcmp(argv[i], "--bench-draw") == 0)
+            benchmarkDraw = true;
+        else if (strcmp(argv[i], "--bench-bloom") == 0)
+            benchmarkBloomPaths = true;
+        else if (strcmp(argv[i], "--pingpong-bloom") == 0)
+            bloomRenderer.mode = BLOOM_PINGPONG;
+        else if (strcmp(argv[i], "--stress") == 0 && i + 1 < argc)
+            badOption |= !parseCount("--stress", argv[++i], stressCount);
+        else if (strcmp(argv[i], "--lights") == 0 && i + 1 < argc)
+            badOption |= !parseCount("--lights", argv[++i], swarmLights);
+        else if (strcmp(argv[i], "--particles") == 0 && i + 1 < argc)
+            badOption |= !parseCount("--particles", argv[++i], particleCount);
+        else if (strcmp(argv[i], "--swarm") == 0 && i + 1 < argc)
+            badOption |= !parseCount("--swarm", argv[++i], swarmCount);
+        else if (strcmp(argv[i], "--swarm-benchmark") == 0)
+            swarmBenchmark = true;
+        else if (strcmp(argv[i], "--clustered") == 0)
+            lightClusters.enabled = true;
+        else if (strcmp(argv[i], "--scene") == 0 && i + 1 < argc)
+            sceneFile = argv[++i];
+        else if (strcmp(argv[i], "--full-vertices") == 0)
+            packedVertices = false;
+        else if (strcmp(argv[i], "--no-geometry-pool") == 0)
+            GeometryPool::enabled = false;
+        else if (strcmp(argv[i], "--deferred") == 0)
+            deferredRenderer.enabled = true;
+        else if (strcmp(argv[i], "--profile-csv") == 0 && i + 1 < argc)
+            profileCsvFile = argv[++i];
+        else if (strcmp(argv[i], "--benchmark") == 0)
+            benchmark = true;
+        else if (strcmp(argv[i], "--benchmark-frames") == 0 && i + 1 < argc)
+            badOption |= !parseCount("--benchmark-frames", argv[++i], benchmarkFrames);
+        else if (strcmp(argv[i], "--benchmark-out") == 0 && i + 1 < argc)
+            benchmarkOutput = argv[++i];
+        else if (strcmp(argv[i], "--light-sweep") == 0 && i + 1 < argc) {
+            std::istringstream counts(argv[++i]);
+            std::string count;
+            unsigned int lights;
+            while (std::getline(counts, count, ','))
+                if (parseCount("--light-sweep", count, lights))
+                    lightSweep.push_back(lights);
+                else
+                    badOption = true;
+            if (!lightSweep.empty()) {
+                benchmark = true;
+                lightClusters.enabled = true;
+                swarmLights = std::max(swarmLights, *std::max_element(lightSweep.begin(), lightSweep.end()));
+            }
+        }
+        else if (strcmp(argv[i], "--golden") == 0 && i + 1 < argc)
+            goldenDirectory = argv[++i];
+        else if (strcmp(argv[i], "--golden-update") == 0)
+            goldenUpdate = true;
+        else
+            std::cout << "Unknown option: " << argv[i] << std::endl;
+    }
+    if (badOption)
+        return 1;
+
+    // the swarm simulation doesn't need a window
+    if (swarmBenchmark) {
+        benchmarkSwarm();
+        return 0;
+    }
+
     // glfw: initialize and configure
     // ------------------------------
     glfwInit();
@@ -113,6 +263,11 @@ int main() {
 #ifdef __APPLE__
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 #endif
+    // the default framebuffer of a hidden window is still rendered to, also with Mesa's software rasterizer
+    bool golden = !goldenDirectory.empty();
+    bool offscreen = benchmark || golden;
+    if (offscreen)
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
 
     // glfw window creation
     // --------------------
@@ -128,7 +283,8 @@ int main() {
     glfwSetScrollCallback(window, scroll_callback);
     glfwSetKeyCallback(window, key_callback);
     // tell GLFW to capture our mouse
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+    if (!offscreen)
+        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
     // glad: load all OpenGL function pointers
     // ---------------------------------------
@@ -140,8 +296,23 @@ int main() {
     // tell stb_image.h to flip loaded texture's on the y-axis (before loading model).
     stbi_set_flip_vertically_on_load(false);
 
+    // offscreen runs don't wait for vsync, and start from the defaults rather than the last session
+    if (offscreen)
+        glfwSwapInterval(0);
+
     programState = new ProgramState;
-    programState->LoadFromFile("resources/program_state.txt");
+    if (!offscreen)
+        programState->LoadFromFile("resources/program_state.txt");
+    std::vector<GoldenPose> goldenPoses;
+    if (golden) {
+        goldenPoses = loadGoldenPoses(goldenDirectory);
+        if (goldenPoses.empty()) {
+            glfwTerminate();
+            return -1;
+        }
+    }
+    float goldenMilliseconds = 0.0f;
+    unsigned int goldenFailures = 0;
     if (programState->ImGuiEnabled) {
         glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
     }
@@ -165,19 +336,88 @@ int main() {
     Shader moonShader("resources/shaders/moon.vs", "resources/shaders/moon.fs");
     Shader fireflyShader("resources/shaders/firefly.vs", "resources/shaders/firefly.fs");
     Shader hdrShader("resources/shaders/hdr.vs", "resources/shaders/hdr.fs");
-    Shader blurShader("resources/shaders/blur.vs", "resources/shaders/blur.fs");
+    Shader blurShader("resources/shaders/bloom_pass.vs", "resources/shaders/blur.fs");
+    Shader bloomDownsampleShader("resources/shaders/bloom_pass.vs", "resources/shaders/bloom_downsample.fs");
+    Shader bloomUpsampleShader("resources/shaders/bloom_pass.vs", "resources/shaders/bloom_upsample.fs");
     Shader bloomShader("resources/shaders/bloom.vs", "resources/shaders/bloom.fs");
-
-    // load models
-    Model treeModel("resources/objects/Tree/Tree Japanese maple N030123.obj");
-    Model toriiModel("resources/objects/Torii/OldTorii.obj");
-    Model lampModel("resources/objects/Lamp/Luster Grannys lamp N251121.obj");
-    Model flowersModel("resources/objects/Flowers/Flowers pot N300622.obj");
-    Model moonModel("resources/objects/moon/moon.obj");
-    Model fireflyModel("resources/objects/firefly/sphere.obj");
-    Model stairsModel("resources/objects/StonePlatforms/StonePlatform_B.obj");
-    Model basePlatformModel("resources/objects/StonePlatforms/StonePlatform_A.obj");
-    Model catModel("resources/objects/Cat/cat.obj");
+    Shader gBufferShader("resources/shaders/model.vs", "resources/shaders/gbuffer.fs");
+    Shader deferredLightShader("resources/shaders/deferred_light.vs", "resources/shaders/deferred_light.fs");
+    Shader particleUpdateShader("resources/shaders/firefly_update.vs", "resources/shaders/firefly_update.fs", nullptr,
+                                {"outPosition", "outVelocity"});
+    Shader particleShader("resources/shaders/firefly_particle.vs", "resources/shaders/firefly_particle.fs");
+
+    // buffer samplers get units of their own, away from the 2D textures on the low units
+    for (Shader *shader : {&ourShader, &moonShader, &fireflyShader, &gBufferShader})
+        IndirectDraws::bindSampler(*shader);
+    for (Shader *shader : {&ourShader, &deferredLightShader})
+        LightClusters::bindSamplers(*shader);
+
+    // shader of every scene pass
+    Shader *passShaders[SCENE_PASS_COUNT];
+    passShaders[SCENE_PASS_LIT] = &ourShader;
+    passShaders[SCENE_PASS_MOON] = &moonShader;
+    passShaders[SCENE_PASS_FIREFLY] = &fireflyShader;
+
+    // load scene and models
+    // ---------------------
+    // models are imported and their textures decoded on worker threads, only the GL upload runs here
+    Scene scene;
+    if (!scene.load(sceneFile)) {
+        glfwTerminate();
+        return -1;
+    }
+    auto modelsLoadStart = std::chrono::steady_clock::now();
+    std::vector<Model> models(scene.models.size());
+    std::vector<std::pair<Model *, std::string>> modelFiles;
+    for (unsigned int i = 0; i < scene.models.size(); i++)
+        modelFiles.push_back({&models[i], scene.models[i].path});
+    if (serialModelLoad) {
+        for (auto &modelFile : modelFiles)
+            modelFile.first->load(modelFile.second);
+    } else {
+        ThreadPool loaderPool;
+        std::vector<std::future<void>> loads;
+        for (auto &modelFile : modelFiles) {
+            Model *model = modelFile.first;
+            std::string path = modelFile.second;
+            loads.push_back(loaderPool.enqueue([model, path] { model->load(path); }));
+        }
+        loaderPool.wait();
+        // rethrows what a load threw on its worker, the same as the serial path would
+        for (std::future<void> &load : loads)
+            load.get();
+        // textures shared between models are only decoded once, all of them in parallel
+        TextureCache::instance().decodePending(loaderPool);
+    }
+    // every model gets the smallest vertex layout holding the attributes of the shaders it's drawn with
+    std::vector<unsigned int> modelAttributes(models.size(), 0);
+    for (const SceneEntity &entity : scene.entities)
+        modelAttributes[entity.model] |= activeVertexAttributes(passShaders[entity.pass]->ID);
+    for (unsigned int i = 0; i < models.size(); i++) {
+        models[i].vertexLayout = packedVertices ? VertexLayout::packedFor(modelAttributes[i]) : VertexLayout::full();
+        models[i].upload();
+    }
+    std::chrono::duration<double, std::milli> modelsLoadTime = std::chrono::steady_clock::now() - modelsLoadStart;
+    std::cout << "Models loaded in " << modelsLoadTime.count() << " ms ("
+              << (serialModelLoad ? "serial" : "parallel") << ", mesh cache "
+              << (MeshCache::enabled ? "enabled" : "disabled") << ")" << std::endl;
+
+    // geometry memory report
+    size_t totalVertexBytes = 0, totalIndexBytes = 0;
+    for (unsigned int i = 0; i < models.size(); i++) {
+        const Model &model = models[i];
+        std::cout << "  " << scene.models[i].name << ": " << model.vertexCount() << " vertices, "
+                  << model.vertexLayout.stride << " bytes/vertex, VBO " << model.vertexBufferBytes() / 1024
+                  << " KiB, EBO " << model.indexBufferBytes() / 1024 << " KiB" << std::endl;
+        totalVertexBytes += model.vertexBufferBytes();
+        totalIndexBytes += model.indexBufferBytes();
+    }
+    std::cout << "  total: VBO " << totalVertexBytes / 1024 << " KiB, EBO " << totalIndexBytes / 1024 << " KiB ("
+              << (packedVertices ? "packed" : "full") << " vertices)" << std::endl;
+    if (GeometryPool::enabled)
+        std::cout << "  geometry pool: " << GeometryPool::instance().arenaCount() << " arenas, "
+                  << GeometryPool::instance().usedBytes() / 1024 << " of "
+                  << GeometryPool::instance().capacityBytes() / 1024 << " KiB in use" << std::endl;
 
     /////////////////////////////////////////////   SKYBOX  ///////////////////////////////////////////////////////////
 
@@ -286,24 +526,38 @@ int main() {
         std::cout << "Framebuffer not complete!" << std::endl;
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
-    // ping-pong-framebuffer for blurring
-    unsigned int pingpongFBO[2];
-    unsigned int pingpongColorbuffers[2];
-    glGenFramebuffers(2, pingpongFBO);
-    glGenTextures(2, pingpongColorbuffers);
-    for (unsigned int i = 0; i < 2; i++) {
-        glBindFramebuffer(GL_FRAMEBUFFER, pingpongFBO[i]);
-        glBindTexture(GL_TEXTURE_2D, pingpongColorbuffers[i]);
-        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, SCR_WIDTH, SCR_HEIGHT, 0, GL_RGBA, GL_FLOAT, NULL);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE); // we clamp to the edge as the blur filter would otherwise sample repeated texture values!
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pingpongColorbuffers[i], 0);
-        // also check if framebuffers are complete (no need for depth buffer)
-        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-            std::cout << "Framebuffer not complete!" << std::endl;
+    // G-buffer of deferred shading, sharing the depth buffer
+    deferredRenderer.init(SCR_WIDTH, SCR_HEIGHT, rboDepth, deferredLightShader);
+    lightClusters.init();
+    std::vector<PointLightStd140> pointLightData;
+
+    // the particle fireflies fill the box around the lit scene
+    glm::vec3 litLower(FLT_MAX), litUpper(-FLT_MAX);
+    for (const SceneEntity &entity : scene.entities)
+        if (entity.pass == SCENE_PASS_LIT) {
+            litLower = glm::min(litLower, entity.position);
+            litUpper = glm::max(litUpper, entity.position);
+        }
+    if (particleCount > 0 && litLower.x <= litUpper.x)
+        fireflyParticles.init(particleCount, (litLower + litUpper) * 0.5f, (litUpper - litLower) * 0.5f + glm::vec3(3.0f),
+                              particleUpdateShader, particleShader);
+
+    // workers of the CPU work in a frame, the swarm steps and the light binning
+    ThreadPool framePool;
+
+    // the CPU swarm flocks in the same box and is drawn with the scene fireflies' mesh
+    unsigned int swarmInstanceVBO = 0;
+    auto swarmEntity = std::find_if(scene.entities.begin(), scene.entities.end(),
+                                    [](const SceneEntity &entity) { return entity.pass == SCENE_PASS_FIREFLY; });
+    if (swarmCount > 0 && swarmEntity != scene.entities.end() && litLower.x <= litUpper.x) {
+        fireflySwarm.scale = swarmEntity->scale * 0.5f;
+        fireflySwarm.init(swarmCount, (litLower + litUpper) * 0.5f, (litUpper - litLower) * 0.5f + glm::vec3(3.0f));
+        glGenBuffers(1, &swarmInstanceVBO);
     }
+    std::vector<glm::vec3> swarmLamps;
+
+    // ping-pong framebuffers and mip chain of the bloom blur
+    bloomRenderer.init(SCR_WIDTH, SCR_HEIGHT, blurShader, bloomDownsampleShader, bloomUpsampleShader);
 
     //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
@@ -328,6 +582,17 @@ int main() {
     glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
     glEnableVertexAttribArray(1);
     glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
+
+    // grass quads are static, so their instance matrices are uploaded once
+    unsigned int grassInstanceVBO;
+    glGenBuffers(1, &grassInstanceVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, grassInstanceVBO);
+    glBufferData(GL_ARRAY_BUFFER, scene.grass.size() * sizeof(glm::mat4), scene.grass.data(), GL_STATIC_DRAW);
+    for (unsigned int column = 0; column < 4; column++) {
+        glEnableVertexAttribArray(INSTANCE_MATRIX_LOCATION + column);
+        glVertexAttribPointer(INSTANCE_MATRIX_LOCATION + column, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(column * sizeof(glm::vec4)));
+        glVertexAttribDivisor(INSTANCE_MATRIX_LOCATION + column, 1);
+    }
     glBindVertexArray(0);
 
     unsigned int grassTexture = loadTexture(FileSystem::getPath("resources/textures/grass.png").c_str());
@@ -341,13 +606,153 @@ int main() {
     hdrShader.use();
     hdrShader.setInt("hdrBuffer", 0);
 
-    blurShader.use();
-    blurShader.setInt("image", 0);
     bloomShader.use();
     bloomShader.setInt("scene", 0);
     bloomShader.setInt("bloomBlur", 1);
     //////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+    // camera and lights are shared by all programs through one uniform buffer
+    FrameConstants frameConstants;
+    frameConstants.init();
+    for (Shader *shader : {&ourShader, &moonShader, &fireflyShader, &grassShader, &skyboxShader, &gBufferShader, &deferredLightShader, &particleShader})
+        FrameConstants::bind(*shader);
+
+    // uniform handles used every frame
+    Uniform<float> shininessUniform = ourShader.uniform<float>("material.shininess");
+    Uniform<float> gBufferShininessUniform = gBufferShader.uniform<float>("material.shininess");
+    Uniform<glm::vec3> moonLightColorUniform = moonShader.uniform<glm::vec3>("lightColor");
+    Uniform<glm::vec3> fireflyColorUniform = fireflyShader.uniform<glm::vec3>("color");
+    Uniform<bool> bloomEnabledUniform = bloomShader.uniform<bool>("bloom");
+    Uniform<float> exposureUniform = bloomShader.uniform<float>("exposure");
+    Uniform<float> bloomStrengthUniform = bloomShader.uniform<float>("bloomStrength");
+
+    unsigned int sceneInstanceVBO;
+    glGenBuffers(1, &sceneInstanceVBO);
+
+    indirectDraws.init();
+    renderQueue.indirectDraws = &indirectDraws;
+    for (Model &model : models)
+        for (Mesh &mesh : model.meshes)
+            indirectDraws.setupVertexArray(mesh.VAO);
+    std::vector<float> recordMaterials;
+
+    renderQueue.profiler = &profiler;
+    // with deferred shading the lit meshes fill the G-buffer layer, which is lit into the HDR framebuffer
+    // before the forward drawn rest of the scene
+    renderQueue.beforeLayer = [&](RenderLayer layer) {
+        if (!deferredRenderer.enabled)
+            return;
+        if (layer == RENDER_LAYER_GBUFFER) {
+            deferredRenderer.beginGeometryPass();
+        } else if (layer == RENDER_LAYER_OPAQUE) {
+            glBindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
+            ProfileScope scope(profiler, "Deferred lighting");
+            deferredRenderer.lightPass(deferredLightShader, frameConstants.lights, frameConstants.camera.view,
+                                       frameConstants.camera.projection, lightClusters.enabled);
+        }
+    };
+    if (!profileCsvFile.empty())
+        profiler.openCsv(profileCsvFile);
+
+    // the benchmark flies around the lit scene as the scene file has it, before --stress adds anything
+    CameraPath benchmarkPath;
+    // a single run, or one per --light-sweep count
+    std::vector<BenchmarkResults> benchmarkRuns(std::max<size_t>(lightSweep.size(), 1));
+    const unsigned int benchmarkRunFrames = BENCHMARK_WARMUP_FRAMES + benchmarkFrames;
+    if (benchmark) {
+        glm::vec3 center(0.0f);
+        unsigned int litEntities = 0;
+        for (const SceneEntity &entity : scene.entities)
+            if (entity.pass == SCENE_PASS_LIT) {
+                center += entity.position;
+                litEntities++;
+            }
+        if (litEntities > 0)
+            center /= (float) litEntities;
+        float radius = 5.0f;
+        for (const SceneEntity &entity : scene.entities)
+            if (entity.pass == SCENE_PASS_LIT)
+                radius = std::max(radius, glm::length(entity.position - center) * 1.5f);
+        benchmarkPath = CameraPath::orbit(center, radius);
+        for (unsigned int run = 0; run < benchmarkRuns.size(); run++) {
+            BenchmarkResults &results = benchmarkRuns[run];
+            results.scene = sceneFile;
+            results.renderer = (const char *) glGetString(GL_RENDERER);
+            results.width = SCR_WIDTH;
+            results.height = SCR_HEIGHT;
+            results.deltaTime = BENCHMARK_DELTA_TIME;
+            results.parameters.push_back({"mip_chain_bloom", bloomRenderer.mode == BLOOM_MIP_CHAIN});
+            if (!lightSweep.empty())
+                results.parameters.push_back({"point_lights", lightSweep[run]});
+        }
+    }
+    unsigned int frame = 0;
+
+    // --stress scatters static copies of the first torii, lamp and firefly entity
+    if (stressCount > 0) {
+        std::mt19937 random(42);
+        std::uniform_real_distribution<float> horizontal(-200.0f, 200.0f);
+        std::uniform_real_distribution<float> vertical(-20.0f, 40.0f);
+        std::uniform_real_distribution<float> angle(0.0f, glm::radians(360.0f));
+        for (const char *name : {"torii", "lamp", "firefly"}) {
+            int model = scene.findModel(name);
+            auto original = std::find_if(scene.entities.begin(), scene.entities.end(),
+                                         [model](const SceneEntity &entity) { return (int) entity.model == model; });
+            if (original == scene.entities.end())
+                continue;
+            SceneEntity copy = *original;
+            copy.name.clear();
+            copy.animated = false;
+            copy.rotationAxis = glm::vec3(0.0f, 1.0f, 0.0f);
+            for (unsigned int i = 0; i < stressCount; i++) {
+                copy.position = glm::vec3(horizontal(random), vertical(random), horizontal(random));
+                copy.rotationAngle = angle(random);
+                scene.entities.push_back(copy);
+            }
+        }
+        scene.finalize();
+        std::cout << "Stress mode: " << stressCount << " extra torii, lamps and fireflies" << std::endl;
+    }
+
+    // --lights adds fireflies drifting around the scene, each carrying a copy of the first flickering light
+    auto swarmTemplate = std::find_if(scene.pointLights.begin(), scene.pointLights.end(),
+                                      [](const ScenePointLight &light) { return light.flicker && light.attach >= 0; });
+    if (swarmLights > 0 && swarmTemplate != scene.pointLights.end()) {
+        std::mt19937 random(7);
+        std::uniform_real_distribution<float> horizontal(-15.0f, 15.0f);
+        std::uniform_real_distribution<float> vertical(-4.0f, 12.0f);
+        std::uniform_real_distribution<float> amplitude(0.5f, 3.0f);
+        std::uniform_real_distribution<float> frequency(0.2f, 1.0f);
+        std::uniform_real_distribution<float> phase(0.0f, glm::radians(360.0f));
+        SceneEntity firefly = scene.entities[swarmTemplate->attach];
+        ScenePointLight light = *swarmTemplate;
+        light.position = glm::vec3(0.0f);
+        firefly.animated = true;
+        firefly.swingAmplitude = 0.0f;
+        for (unsigned int i = 0; i < swarmLights; i++) {
+            firefly.name = "swarm" + std::to_string(i);
+            firefly.position = glm::vec3(horizontal(random), vertical(random), horizontal(random));
+            firefly.oscillateAmplitude = glm::vec3(amplitude(random), amplitude(random) * 0.3f, amplitude(random));
+            firefly.oscillateFrequency = glm::vec3(frequency(random), frequency(random), frequency(random));
+            firefly.oscillatePhase = glm::vec3(phase(random), phase(random), phase(random));
+            scene.entities.push_back(firefly);
+            light.attachName = firefly.name;
+            scene.pointLights.push_back(light);
+        }
+        scene.finalize();
+        lightClusters.enabled = true;
+        std::cout << "Swarm: " << swarmLights << " extra fireflies with point lights, clustered lighting on" << std::endl;
+    }
+
+    if (benchmarkDraw) {
+        glBindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
+        frameConstants.upload();
+        benchmarkModelDraw(ourShader, modelFiles, 1000);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+    if (benchmarkBloomPaths)
+        benchmarkBloom(blurShader, bloomDownsampleShader, bloomUpsampleShader);
+
     // draw in wireframe
     //glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 
@@ -356,353 +761,285 @@ int main() {
     while (!glfwWindowShouldClose(window)) {
         // per-frame time logic
         // --------------------
-        float currentFrame = glfwGetTime();
+        auto frameStart = std::chrono::steady_clock::now();
+        // golden images are all taken at the same point of the animations
+        float currentFrame = benchmark ? (frame % benchmarkRunFrames) * BENCHMARK_DELTA_TIME : golden ? 0.0f : glfwGetTime();
         deltaTime = currentFrame - lastFrame;
         lastFrame = currentFrame;
 
         // input
         // -----
-        processInput(window);
+        if (benchmark) {
+            benchmarkPath.apply(programState->camera, (float) (frame % benchmarkRunFrames) / benchmarkRunFrames);
+        } else if (golden) {
+            if (frame % GOLDEN_FRAMES_PER_POSE == 0) {
+                programState->LoadFromFile(goldenPoses[frame / GOLDEN_FRAMES_PER_POSE].stateFile);
+                programState->ImGuiEnabled = false;
+            }
+        } else {
+            processInput(window);
+        }
 
+        profiler.beginFrame();
 
         // render
-        ourShader.use();
+        profiler.begin("Scene update");
         glBindFramebuffer(GL_FRAMEBUFFER, hdrFBO);
         glClearColor(programState->clearColor.r, programState->clearColor.g, programState->clearColor.b, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        // Moon position
-        float moonT = glfwGetTime();
-        float moonV = 0.4;
-        float moonR = 30.0;
-        float moonX = cos(moonT*moonV)*moonR;
-        float moonY = 15.0f;
-        float moonZ = sin(moonT*moonV)*moonR;
-
-        // Lamp1 light position
-        float lampAngle = glm::radians((float)cos(glfwGetTime())*100.0f)/4.0f;
-        float Y1init = 2.2f;
-        float Z1init = -11.0f;
-        float lamp1Y = Y1init + Y1init * cos(lampAngle);
-        float lamp1Z = Z1init - Y1init * tan(lampAngle);
-
-        // Lamp2 light position
-        float Y2init = -1.2f;
-        float Z2init = 17.0f;
-        float lamp2Y = lamp1Y - 5.0f;
-        float lamp2Z = lamp1Z + 11.0f + 17.0f;
-
-        ourShader.use();
+        // animated entities and the lights following them
+        scene.animate(currentFrame);
+        scene.writeLights(frameConstants.lights);
+        scene.writePointLights(pointLightData);
+        // the swarm gathers around the steady lights, taken before a --light-sweep run drops some of them
+        swarmLamps.clear();
+        for (unsigned int i = 0; i < scene.pointLights.size(); i++)
+            if (!scene.pointLights[i].flicker)
+                swarmLamps.push_back(pointLightData[i].position);
+        frameConstants.camera.viewPos = programState->camera.Position;
 
         // DirLight - Moon
-        glm::vec3 moonColor;
-        glm::vec3 moonLightColor;
+        glm::vec3 moonColor = scene.dirLight.diffuse;
         if (bloodMoon) {
             moonColor = glm::vec3(1.5, 0.3, 0.0);
-            moonLightColor = glm::vec3(0.1f);
-        }
-        else {
-            moonColor = glm::vec3(1.5, 1.0, 0.7);
-            moonLightColor = moonColor;
+            frameConstants.lights.dirLight.diffuse = glm::vec3(0.1f);
         }
-        ourShader.setVec3("dirLight.ambient", glm::vec3(0.0, 0.0, 0.0));
-        ourShader.setVec3("dirLight.diffuse", moonLightColor);
-        ourShader.setVec3("dirLight.specular", glm::vec3(0.0f));
-        ourShader.setVec3("dirLight.direction", glm::vec3(-moonX, -moonY, -moonZ));
-        ourShader.setVec3("viewPos", programState->camera.Position);
-
-        // PointLight - Lamp1
-        ourShader.setVec3("lamp1.ambient", glm::vec3(0.0, 0.0, 0.0));
-        ourShader.setVec3("lamp1.diffuse", glm::vec3(1.0, 0.0, 0.3));
-        ourShader.setVec3("lamp1.specular", glm::vec3(1.0, 0.0, 0.3)*3.0f);
-        ourShader.setFloat("lamp1.constant", 1.0f);
-        ourShader.setFloat("lamp1.linear", 0.09f);
-        ourShader.setFloat("lamp1.quadratic", 0.03f);
-        ourShader.setVec3("lamp1.position", glm::vec3(0.0f, lamp1Y, lamp1Z));
-
-        // PointLight - Lamp2
-        ourShader.setVec3("lamp2.ambient", glm::vec3(0.0, 0.0, 0.0));
-        ourShader.setVec3("lamp2.diffuse", glm::vec3(1.0, 0.3, 0.0));
-        ourShader.setVec3("lamp2.specular", glm::vec3(1.0, 0.3, 0.0)*3.0f);
-        ourShader.setFloat("lamp2.constant", 1.0f);
-        ourShader.setFloat("lamp2.linear", 0.09f);
-        ourShader.setFloat("lamp2.quadratic", 0.03f);
-        ourShader.setVec3("lamp2.position", glm::vec3(0.4f, lamp2Y, lamp2Z));
 
         // PointLights - fireflies
-        float green = cos(glfwGetTime()) + 1.5f;
+        float green = cos(currentFrame) + 1.5f;
         float red = 2.0f;
         glm::vec3 fireflyColor = glm::vec3(red, green, 0.0f);
-        glm::vec3 fireflyAmbient = glm::vec3(0.0, 0.0, 0.0);
-        glm::vec3 fireflyDiffuse = fireflyColor * 0.5f;
-        glm::vec3 fireflySpecular = fireflyColor * 0.5f;
-
-        float fireflyConstant = 1.0f;
-        float fireflyLinear = 1.0f;
-        float fireflyQuadratic = 1.0f;
-
-        // Torii firefly
-        glm::vec3 toriiFireflyPos = glm::vec3(cos(glfwGetTime())*0.6+1.7f, 0.7f, -cos(glfwGetTime())*0.6f);
-        ourShader.setVec3("fireflies[0].ambient", fireflyAmbient);
-        ourShader.setVec3("fireflies[0].diffuse", fireflyDiffuse);
-        ourShader.setVec3("fireflies[0].specular", fireflySpecular);
-        ourShader.setFloat("fireflies[0].constant", fireflyConstant);
-        ourShader.setFloat("fireflies[0].linear", fireflyLinear);
-        ourShader.setFloat("fireflies[0].quadratic", fireflyQuadratic);
-        ourShader.setVec3("fireflies[0].position", toriiFireflyPos);
-
-        // Tree firefly
-        glm::vec3 treeFireflyPos = glm::vec3(1.0f + cos(glfwGetTime()*2.0f)*0.4f, 10.5f, 7.0f);
-        ourShader.setVec3("fireflies[1].ambient", fireflyAmbient);
-        ourShader.setVec3("fireflies[1].diffuse", fireflyDiffuse);
-        ourShader.setVec3("fireflies[1].specular", fireflySpecular);
-        ourShader.setFloat("fireflies[1].constant", fireflyConstant);
-        ourShader.setFloat("fireflies[1].linear", fireflyLinear);
-        ourShader.setFloat("fireflies[1].quadratic", fireflyQuadratic);
-        ourShader.setVec3("fireflies[1].position", treeFireflyPos);
-
-        // Flowers firefly
-        glm::vec3 flowersFireflyPos = glm::vec3(cos(glfwGetTime()) + 6.0, 2.0f, -cos(glfwGetTime()*4.0f));
-        ourShader.setVec3("fireflies[2].ambient", fireflyAmbient);
-        ourShader.setVec3("fireflies[2].diffuse", fireflyDiffuse);
-        ourShader.setVec3("fireflies[2].specular", fireflySpecular);
-        ourShader.setFloat("fireflies[2].constant", fireflyConstant);
-        ourShader.setFloat("fireflies[2].linear", fireflyLinear);
-        ourShader.setFloat("fireflies[2].quadratic", fireflyQuadratic);
-        ourShader.setVec3("fireflies[2].position", flowersFireflyPos);
+        for (unsigned int i = 0; i < scene.pointLights.size(); i++) {
+            if (scene.pointLights[i].flicker) {
+                pointLightData[i].diffuse = fireflyColor * 0.5f;
+                pointLightData[i].specular = fireflyColor * 0.5f;
+                if (i < MAX_POINT_LIGHTS) {
+                    frameConstants.lights.pointLights[i].diffuse = fireflyColor * 0.5f;
+                    frameConstants.lights.pointLights[i].specular = fireflyColor * 0.5f;
+                }
+            }
+        }
 
         // Spotlight - Torch
-        ourShader.setBool("bTorch", bTorch);
-        ourShader.setVec3("torch.ambient", glm::vec3(0.0, 0.0, 0.0));
-        ourShader.setVec3("torch.diffuse", glm::vec3(spotlightRed, spotlightGreen, spotlightBlue)*spotlightIntensity);
-        ourShader.setVec3("torch.specular", glm::vec3(spotlightRed, spotlightGreen, spotlightBlue)*spotlightIntensity);
-        ourShader.setFloat("torch.constant", 1.0f);
-        ourShader.setFloat("torch.linear", 0.09f);
-        ourShader.setFloat("torch.quadratic", 0.03f);
-        ourShader.setVec3("torch.position", programState->camera.Position);
-        ourShader.setVec3("torch.direction", programState->camera.Front);
-        ourShader.setFloat("torch.cutOff", cos(glm::radians(12.0f)));
-        ourShader.setFloat("torch.outerCutOff", cos(glm::radians(15.0f)));
-
-        // view/projection transformations
+        frameConstants.lights.bTorch = bTorch;
+        frameConstants.lights.torch.diffuse = glm::vec3(spotlightRed, spotlightGreen, spotlightBlue)*spotlightIntensity;
+        frameConstants.lights.torch.specular = glm::vec3(spotlightRed, spotlightGreen, spotlightBlue)*spotlightIntensity;
+        frameConstants.lights.torch.position = programState->camera.Position;
+        frameConstants.lights.torch.direction = programState->camera.Front;
+
+        // view/projection transformations, uploaded together with the lights for all programs
         glm::mat4 projection = glm::perspective(glm::radians(programState->camera.Zoom),
                                                 (float) SCR_WIDTH / (float) SCR_HEIGHT, 0.1f, 1000.0f);
         glm::mat4 view = programState->camera.GetViewMatrix();
-        ourShader.setMat4("projection", projection);
-        ourShader.setMat4("view", view);
-
-        // Base Platform
-        glm::mat4 model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(0.0f, -10.0f, 4.0f));
-        model = glm::scale(model, glm::vec3(2.0f));
-        ourShader.setMat4("model", model);
-        ourShader.setFloat("material.shininess", 1.0);
-        basePlatformModel.Draw(ourShader);
-
-        // Smaller Platform
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(0.0f, -2.8f, -4.0f));
-        model = glm::scale(model, glm::vec3(1.0f));
-        ourShader.setMat4("model", model);
-        ourShader.setFloat("material.shininess", 1.0);
-        basePlatformModel.Draw(ourShader);
-
-        // Stairs
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(0.0f, -2.2f, 10.0f));
-        model = glm::scale(model, glm::vec3(0.5f));
-        ourShader.setMat4("model", model);
-        ourShader.setFloat("material.shininess", 1.0);
-        stairsModel.Draw(ourShader);
-
-        // Torii
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(0.0f, 0.0f, -11.0f));
-        model = glm::scale(model, glm::vec3(0.5f));
-        ourShader.setMat4("model", model);
-        ourShader.setFloat("material.shininess", 1.0);
-        toriiModel.Draw(ourShader);
-
-        // Lamp
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(0.0f, 5.2f, -11.0f));
-        model = glm::scale(model, glm::vec3(0.003f));
-        model = glm::rotate(model, lampAngle, glm::vec3(1.0, 0.0, 0.0));
-        ourShader.setMat4("model", model);
-        ourShader.setFloat("material.shininess", 1.0);
-        lampModel.Draw(ourShader);
-
-        // Cat
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(7.0f, -4.0f, 15.0f));
-        model = glm::scale(model, glm::vec3(0.04f));
-        ourShader.setMat4("model", model);
-        ourShader.setFloat("material.shininess", 1.0);
-        catModel.Draw(ourShader);
-
-        // Torii2
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(0.4f, -5.0, 17.0f));
-        model = glm::scale(model, glm::vec3(0.5f));
-        ourShader.setMat4("model", model);
-        ourShader.setFloat("material.shininess", 1.0);
-        toriiModel.Draw(ourShader);
-
-        // Lamp2
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(0.4f, 0.2f, 17.0f));
-        model = glm::scale(model, glm::vec3(0.003f));
-        model = glm::rotate(model, lampAngle, glm::vec3(1.0, 0.0, 0.0));
-        ourShader.setMat4("model", model);
-        ourShader.setFloat("material.shininess", 1.0);
-        lampModel.Draw(ourShader);
-
-
-        // Tree
-        glDisable(GL_CULL_FACE); // all leaves are rendered
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(0.0f, 0.0f, 0.0f));
-        model = glm::scale(model, glm::vec3(0.05f));
-        ourShader.setMat4("model", model);
-        ourShader.setFloat("material.shininess", 1.0);
-        treeModel.Draw(ourShader);
-        // Flowers
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(6.0f, 0.0f, 0.0f));
-        model = glm::scale(model, glm::vec3(0.003f));
-        ourShader.setMat4("model", model);
-        ourShader.setFloat("material.shininess", 1.0);
-        flowersModel.Draw(ourShader);
-        glEnable(GL_CULL_FACE);
-
-        // Moon
+        frameConstants.camera.projection = projection;
+        frameConstants.camera.view = view;
+        frameConstants.upload();
+
+        // clustered point lights, all of them instead of the first MAX_POINT_LIGHTS in the Lights block
+        if (lightClusters.enabled) {
+            // the scene's own lights come first, a sweep run lights only its count
+            if (benchmark && !lightSweep.empty())
+                pointLightData.resize(std::min<size_t>(pointLightData.size(), lightSweep[frame / benchmarkRunFrames]));
+            lightClusters.build(pointLightData, view, projection, SCR_WIDTH, SCR_HEIGHT, &framePool);
+        }
+        lightClusters.apply(ourShader);
+        lightClusters.apply(deferredLightShader);
+
         moonShader.use();
-        moonShader.setVec3("lightColor", moonColor);
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(moonX, moonY, moonZ));
-        model = glm::scale(model, glm::vec3(1.5f));
-        moonShader.setMat4("model", model);
-        moonShader.setMat4("view", view);
-        moonShader.setMat4("projection", projection);
-        moonModel.Draw(moonShader);
-
-        // Fireflies
-        float fireflyScale = 1.0f;
+        moonShader.set(moonLightColorUniform, moonColor);
         fireflyShader.use();
-        fireflyShader.setVec3("color", fireflyColor);
-        fireflyShader.setMat4("projection", projection);
-        fireflyShader.setMat4("view", view);
-        // Firefly - Flowers
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, flowersFireflyPos);
-        model = glm::scale(model, glm::vec3(fireflyScale));
-        fireflyShader.setMat4("model", model);
-        fireflyModel.Draw(fireflyShader);
-
-        // Firefly - Tree
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, treeFireflyPos);
-        model = glm::scale(model, glm::vec3(fireflyScale));
-        fireflyShader.setMat4("model", model);
-        fireflyModel.Draw(fireflyShader);
-
-        // Firefly - Torii
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, toriiFireflyPos);
-        model = glm::scale(model, glm::vec3(fireflyScale));
-        fireflyShader.setMat4("model", model);
-        fireflyModel.Draw(fireflyShader);
-
-        // Grass
-        glDisable(GL_CULL_FACE);
-        grassShader.use();
-        grassShader.setMat4("projection", projection);
-        grassShader.setMat4("view", view);
-        glBindVertexArray(grassVAO);
-        glBindTexture(GL_TEXTURE_2D, grassTexture);
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(1.2f, -3.8f, 17.35f));
-        model = glm::scale(model, glm::vec3(2.0f));
-        grassShader.setMat4("model", model);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-        glEnable(GL_CULL_FACE);
-        model = glm::mat4(1.0f);
-        model = glm::translate(model, glm::vec3(-2.3f, -3.8f, 17.4f));
-        model = glm::scale(model, glm::vec3(2.0f));
-        grassShader.setMat4("model", model);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-        glEnable(GL_CULL_FACE);
-
-        //////////////////////////////////////  SKYBOX  //////////////////////////////////////////////////////////////
-
-        glDepthFunc(GL_LEQUAL);
-        skyboxShader.use();
-        view = glm::mat4(glm::mat3(programState->camera.GetViewMatrix()));
-        skyboxShader.setMat4("view", view);
-        skyboxShader.setMat4("projection", projection);
-        glBindVertexArray(skyboxVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-        glBindVertexArray(0);
-        glDepthFunc(GL_LESS);
+        fireflyShader.set(fireflyColorUniform, fireflyColor);
+
+        // world matrices of the mesh instances in view go up in one buffer, every batch mesh draws its own range of it.
+        // indirect draws get them (and their batch's shininess) as records instead
+        sceneCuller.cull(Frustum::fromMatrix(projection * view),
+                         LodView::fromCamera(programState->camera.Position, programState->camera.Zoom, SCR_HEIGHT), scene, models);
+        const std::vector<glm::mat4> &visibleTransforms = sceneCuller.transforms;
+        if (indirectDraws.enabled) {
+            recordMaterials.resize(visibleTransforms.size());
+            for (const SceneCuller::Range &range : sceneCuller.ranges)
+                std::fill(recordMaterials.begin() + range.first, recordMaterials.begin() + range.first + range.count,
+                          scene.batches[range.batch].shininess);
+            indirectDraws.uploadRecords(visibleTransforms, recordMaterials);
+        } else {
+            glBindBuffer(GL_ARRAY_BUFFER, sceneInstanceVBO);
+            glBufferData(GL_ARRAY_BUFFER, visibleTransforms.size() * sizeof(glm::mat4), nullptr, GL_STREAM_DRAW);
+            glBufferSubData(GL_ARRAY_BUFFER, 0, visibleTransforms.size() * sizeof(glm::mat4), visibleTransforms.data());
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+        }
+        profiler.end();
+
+        // the swarm keeps away from the camera and gathers around swarmLamps
+        if (swarmEnabled && fireflySwarm.size() > 0) {
+            ProfileScope scope(profiler, "Swarm");
+            fireflySwarm.update(deltaTime, programState->camera.Position, swarmLamps, &framePool);
+            const std::vector<glm::mat4> &swarmTransforms = fireflySwarm.instanceTransforms();
+            glBindBuffer(GL_ARRAY_BUFFER, swarmInstanceVBO);
+            glBufferData(GL_ARRAY_BUFFER, swarmTransforms.size() * sizeof(glm::mat4), nullptr, GL_STREAM_DRAW);
+            glBufferSubData(GL_ARRAY_BUFFER, 0, swarmTransforms.size() * sizeof(glm::mat4), swarmTransforms.data());
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+        }
+
+        // everything is queued and drawn sorted by render state
+        for (const SceneCuller::Range &range : sceneCuller.ranges) {
+            const SceneBatch &batch = scene.batches[range.batch];
+            bool deferred = deferredRenderer.enabled && batch.pass == SCENE_PASS_LIT;
+            RenderLayer layer = deferred ? RENDER_LAYER_GBUFFER : RENDER_LAYER_OPAQUE;
+            Shader &shader = deferred ? gBufferShader : *passShaders[batch.pass];
+            Mesh &mesh = models[batch.model].meshes[range.mesh];
+            if (indirectDraws.enabled) {
+                renderQueue.submitMeshIndirect(layer, shader, mesh, !batch.doubleSided, range.first, range.count,
+                                               range.lod);
+                continue;
+            }
+            GLint materialLocation = batch.pass != SCENE_PASS_LIT ? -1
+                                   : deferred ? gBufferShininessUniform.location : shininessUniform.location;
+            renderQueue.submitMesh(layer, shader, mesh, !batch.doubleSided,
+                                   sceneInstanceVBO, range.first * sizeof(glm::mat4), range.count, materialLocation, batch.shininess,
+                                   range.lod);
+        }
+        if (swarmEnabled && fireflySwarm.size() > 0)
+            for (Mesh &mesh : models[swarmEntity->model].meshes)
+                renderQueue.submitMesh(RENDER_LAYER_OPAQUE, fireflyShader, mesh, true, swarmInstanceVBO, 0, fireflySwarm.size());
+        renderQueue.submitArrays(RENDER_LAYER_OPAQUE, grassShader, grassVAO, GL_TEXTURE_2D, grassTexture,
+                                 6, scene.grass.size(), false);
+        renderQueue.submitArrays(RENDER_LAYER_SKY, skyboxShader, skyboxVAO, GL_TEXTURE_CUBE_MAP, cubemapTexture,
+                                 36, 1, true, GL_LEQUAL);
+        renderQueue.flush();
+
+        // GPU fireflies, after the sky so they're blended over everything
+        if (fireflyParticles.enabled) {
+            ProfileScope scope(profiler, "Particles");
+            fireflyParticles.update(particleUpdateShader, currentFrame, deltaTime);
+            fireflyParticles.draw(particleShader, fireflyColor, currentFrame, projection[1][1] * SCR_HEIGHT * 0.5f);
+        }
 
         /////////////////////////////////////    HDR & BLOOM     /////////////////////////////////////////////////////
 
         glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
-        // 2. blur bright fragments with two-pass Gaussian Blur
+        // 2. blur bright fragments, down and up a mip chain or with two-pass Gaussian Blur
         // --------------------------------------------------
-        bool horizontal = true, first_iteration = true;
-        unsigned int amount = 10;
-        blurShader.use();
-        for (unsigned int i = 0; i < amount; i++) {
-            glBindFramebuffer(GL_FRAMEBUFFER, pingpongFBO[horizontal]);
-            blurShader.setInt("horizontal", horizontal);
-            glBindTexture(GL_TEXTURE_2D, first_iteration ? colorBuffers[1] : pingpongColorbuffers[!horizontal]);  // bind texture of other framebuffer (or scene if first iteration)
-            renderQuad();
-            horizontal = !horizontal;
-            if (first_iteration)
-                first_iteration = false;
-        }
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        profiler.begin(bloomRenderer.mode == BLOOM_MIP_CHAIN ? "Bloom mip chain" : "Blur");
+        GLuint bloomTexture = bloomRenderer.render(colorBuffers[1], blurShader, bloomDownsampleShader, bloomUpsampleShader);
+        profiler.end();
 
         // 3. now render floating point color buffer to 2D quad and tonemap HDR colors to default framebuffer's (clamped) color range
         // --------------------------------------------------------------------------------------------------------------------------
+        profiler.begin("Bloom composite");
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
         bloomShader.use();
         glActiveTexture(GL_TEXTURE0);
         glBindTexture(GL_TEXTURE_2D, colorBuffers[0]);
         glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, pingpongColorbuffers[!horizontal]);
-        bloomShader.setInt("bloom", true);
-        bloomShader.setFloat("exposure", exposure);
+        glBindTexture(GL_TEXTURE_2D, bloomTexture);
+        bloomShader.set(bloomEnabledUniform, true);
+        bloomShader.set(bloomStrengthUniform, bloomRenderer.strength());
+        bloomShader.set(exposureUniform, exposure);
         renderQuad();
+        profiler.end();
 
-        if (programState->ImGuiEnabled)
+        if (programState->ImGuiEnabled) {
+            ProfileScope scope(profiler, "ImGui");
             DrawImGui(programState);
+        }
+        profiler.endFrame();
+
+        // the back buffer is only defined until it's swapped
+        if (golden && frame % GOLDEN_FRAMES_PER_POSE == GOLDEN_FRAMES_PER_POSE - 1) {
+            const GoldenPose &pose = goldenPoses[frame / GOLDEN_FRAMES_PER_POSE];
+            Image image = Image::readFramebuffer(SCR_WIDTH, SCR_HEIGHT);
+            std::string referenceFile = goldenDirectory + "/" + pose.name + ".ppm";
+            float milliseconds = goldenMilliseconds / GOLDEN_TIMED_FRAMES;
+            goldenMilliseconds = 0.0f;
+            Image reference;
+            if (goldenUpdate) {
+                if (image.write(referenceFile))
+                    std::cout << "Golden " << pose.name << ": reference written, " << milliseconds << " ms/frame" << std::endl;
+                else
+                    goldenFailures++;
+            } else if (!reference.read(referenceFile)) {
+                std::cout << "ERROR::GOLDEN_IMAGE:: no reference image " << referenceFile << ", run with --golden-update" << std::endl;
+                image.write(goldenDirectory + "/" + pose.name + ".actual.ppm");
+                goldenFailures++;
+            } else {
+                ImageDiff diff = ImageDiff::compare(reference, image, GOLDEN_THRESHOLD);
+                bool passed = diff.differentPixels <= GOLDEN_MAX_DIFFERENT_PIXELS * SCR_WIDTH * SCR_HEIGHT;
+                std::cout << "Golden " << pose.name << ": " << (passed ? "PASS" : "FAIL") << ", " << diff.differentPixels
+                          << " pixels differ (largest difference " << diff.maxDelta << "), " << milliseconds << " ms/frame" << std::endl;
+                if (!passed) {
+                    image.write(goldenDirectory + "/" + pose.name + ".actual.ppm");
+                    diff.heatmap.write(goldenDirectory + "/" + pose.name + ".diff.ppm");
+                    goldenFailures++;
+                }
+            }
+            if (frame / GOLDEN_FRAMES_PER_POSE + 1 == goldenPoses.size())
+                glfwSetWindowShouldClose(window, true);
+        }
 
         // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
         // -------------------------------------------------------------------------------
         glfwSwapBuffers(window);
         glfwPollEvents();
+
+        if (benchmark) {
+            // the first frames compile shaders and fill caches in the driver, they don't count
+            if (frame % benchmarkRunFrames >= BENCHMARK_WARMUP_FRAMES)
+                benchmarkRuns[frame / benchmarkRunFrames].addFrame(
+                        std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - frameStart).count(),
+                        renderQueue.drawCalls, renderQueue.sortedStats.draws);
+            if (frame + 1 >= benchmarkRunFrames * benchmarkRuns.size())
+                glfwSetWindowShouldClose(window, true);
+        }
+        if (golden) {
+            unsigned int step = frame % GOLDEN_FRAMES_PER_POSE;
+            if (step >= GOLDEN_WARMUP_FRAMES && step < GOLDEN_WARMUP_FRAMES + GOLDEN_TIMED_FRAMES)
+                goldenMilliseconds += std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - frameStart).count();
+        }
+        frame++;
     }
 
-    programState->SaveToFile("resources/program_state.txt");
+    if (benchmark) {
+        std::ofstream file;
+        if (!benchmarkOutput.empty()) {
+            file.open(benchmarkOutput);
+            if (!file)
+                std::cout << "ERROR::BENCHMARK:: can't write " << benchmarkOutput << std::endl;
+        }
+        std::ostream &out = benchmarkOutput.empty() ? std::cout : file;
+        if (lightSweep.empty())
+            benchmarkRuns[0].writeJson(out);
+        else
+            BenchmarkResults::writeJson(out, benchmarkRuns);
+    } else if (!golden) {
+        programState->SaveToFile("resources/program_state.txt");
+    }
     delete programState;
     ImGui_ImplOpenGL3_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
 
+    frameConstants.destroy();
     glDeleteVertexArrays(1, &skyboxVAO);
     glDeleteBuffers(1, &skyboxVBO);
     glDeleteVertexArrays(1, &grassVAO);
     glDeleteBuffers(1, &grassVBO);
+    glDeleteBuffers(1, &grassInstanceVBO);
+    glDeleteBuffers(1, &sceneInstanceVBO);
+    GeometryPool::instance().clear();
+    indirectDraws.destroy();
+    profiler.destroy();
+    deferredRenderer.destroy();
+    lightClusters.destroy();
+    fireflyParticles.destroy();
+    glDeleteBuffers(1, &swarmInstanceVBO);
+    bloomRenderer.destroy();
 
     // glfw: terminate, clearing all previously allocated GLFW resources.
     // ------------------------------------------------------------------
     glfwTerminate();
-    return 0;
+    return goldenFailures > 0 ? 1 : 0;
 }
 
 // process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
@@ -771,10 +1108,87 @@ void DrawImGui(ProgramState *programState) {
     {
         ImGui::Begin("Camera info");
         const Camera& c = programState->camera;
+        ImGui::Text("Frame time: %.2f ms", deltaTime * 1000.0f);
         ImGui::Text("Camera position: (%f, %f, %f)", c.Position.x, c.Position.y, c.Position.z);
         ImGui::Text("(Yaw, Pitch): (%f, %f)", c.Yaw, c.Pitch);
         ImGui::Text("Camera front: (%f, %f, %f)", c.Front.x, c.Front.y, c.Front.z);
         ImGui::Checkbox("Camera mouse update", &programState->CameraMouseMovementUpdateEnabled);
+        ImGui::Checkbox("Frustum culling", &sceneCuller.enabled);
+        ImGui::Text("Meshes visible: %u, culled: %u", sceneCuller.visibleCount, sceneCuller.culledCount);
+        ImGui::Checkbox("Levels of detail", &sceneCuller.lodEnabled);
+        ImGui::SliderFloat("LOD pixel error", &sceneCuller.lodPixelError, 0.25f, 8.0f);
+        ImGui::SliderFloat("LOD hysteresis", &sceneCuller.lodHysteresis, 0.0f, 0.9f);
+        for (unsigned int lod = 0; lod < sceneCuller.lodCounts.size(); lod++)
+            ImGui::Text("LOD %u: %u meshes", lod, sceneCuller.lodCounts[lod]);
+        ImGui::End();
+    }
+
+    {
+        ImGui::Begin("Render queue");
+        const RenderQueue::Stats &unsorted = renderQueue.unsortedStats;
+        const RenderQueue::Stats &sorted = renderQueue.sortedStats;
+        ImGui::Checkbox("Sort by render state", &renderQueue.sortEnabled);
+        ImGui::Checkbox("Indirect draws", &indirectDraws.enabled);
+        ImGui::Checkbox("Deferred shading", &deferredRenderer.enabled);
+        ImGui::Checkbox("Clustered lights", &lightClusters.enabled);
+        bool mipChainBloom = bloomRenderer.mode == BLOOM_MIP_CHAIN;
+        if (ImGui::Checkbox("Mip chain bloom", &mipChainBloom))
+            bloomRenderer.mode = mipChainBloom ? BLOOM_MIP_CHAIN : BLOOM_PINGPONG;
+        ImGui::Checkbox("GPU fireflies", &fireflyParticles.enabled);
+        if (fireflyParticles.enabled)
+            ImGui::Text("Particles: %u", fireflyParticles.count);
+        if (fireflySwarm.size() > 0) {
+            ImGui::Checkbox("CPU swarm", &swarmEnabled);
+            ImGui::Text("Swarm: %u agents, grid %.2f ms, steering %.2f ms, integration %.2f ms", fireflySwarm.size(),
+                        fireflySwarm.gridMilliseconds, fireflySwarm.steerMilliseconds, fireflySwarm.integrateMilliseconds);
+        }
+        if (lightClusters.enabled)
+            ImGui::Text("Point lights: %u, cluster entries: %u (at most %u), binned in %.3f ms", lightClusters.lightCount,
+                        lightClusters.indexCount, lightClusters.maxClusterLights, lightClusters.buildMilliseconds);
+        if (deferredRenderer.enabled)
+            ImGui::Text("Point light passes: %u, %.1f%% of the screen", deferredRenderer.pointLightPasses,
+                        100.0f * deferredRenderer.pointLightPixels / (SCR_WIDTH * SCR_HEIGHT));
+        if (indirectDraws.multiDrawSupported())
+            ImGui::Checkbox("glMultiDrawElementsIndirect", &indirectDraws.multiDraw);
+        else
+            ImGui::Text("glMultiDrawElementsIndirect not supported");
+        ImGui::Text("Draws: %u, GL draw calls: %u", sorted.draws, renderQueue.drawCalls);
+        ImGui::Text("CPU submit time: %.3f ms (geometry pool %s)", renderQueue.flushMilliseconds,
+                    GeometryPool::enabled ? "on" : "off");
+        ImGui::Text("State changes   submitted / sorted");
+        ImGui::Text("Programs:       %9u / %u", unsorted.programs, sorted.programs);
+        ImGui::Text("Textures:       %9u / %u", unsorted.textures, sorted.textures);
+        ImGui::Text("VAOs:           %9u / %u", unsorted.vaos, sorted.vaos);
+        ImGui::Text("Cull state:     %9u / %u", unsorted.cullStates, sorted.cullStates);
+        ImGui::Text("Depth state:    %9u / %u", unsorted.depthStates, sorted.depthStates);
+        ImGui::End();
+    }
+
+    {
+        ImGui::Begin("Profiler");
+        ImGui::Checkbox("Enabled", &profiler.enabled);
+        ImGui::Text("Section              CPU ms    GPU ms");
+        for (const Profiler::Section &section : profiler.sections)
+            ImGui::Text("%-18s %8.3f  %8.3f", section.name.c_str(), section.cpuAverage, section.gpuAverage);
+        if (!profiler.sections.empty()) {
+            // the whole frame is always the first section
+            const Profiler::Section &frame = profiler.sections[0];
+            ImGui::PlotLines("CPU frame", frame.cpuHistory.data(), frame.cpuHistory.size(), profiler.historyHead,
+                             nullptr, 0.0f, FLT_MAX, ImVec2(0, 60));
+            ImGui::PlotLines("GPU frame", frame.gpuHistory.data(), frame.gpuHistory.size(), profiler.historyHead,
+                             nullptr, 0.0f, FLT_MAX, ImVec2(0, 60));
+
+            // how GPU frame times are distributed, from 0 to the slowest frame of the history
+            const int bins = 32;
+            float bucket[bins] = {};
+            float slowest = *std::max_element(frame.gpuHistory.begin(), frame.gpuHistory.end());
+            for (float milliseconds : frame.gpuHistory)
+                if (milliseconds > 0.0f && slowest > 0.0f)
+                    bucket[std::min(bins - 1, (int) (milliseconds / slowest * bins))] += 1.0f;
+            char label[32];
+            snprintf(label, sizeof(label), "0 - %.1f ms", slowest);
+            ImGui::PlotHistogram("GPU frame times", bucket, bins, 0, label, 0.0f, FLT_MAX, ImVec2(0, 60));
+        }
         ImGui::End();
     }
 
@@ -892,4 +1306,118 @@ unsigned int loadTexture(char const * path) {
     }
 
     return textureID;
-}
\ No newline at end of file
+}
+
+// measures the CPU time of Model::Draw for every model; draws are only submitted, the GPU isn't waited on
+// -------------------------------------------------------------------------------------------------------
+void benchmarkModelDraw(Shader &shader, const std::vector<std::pair<Model *, std::string>> &models, unsigned int iterations) {
+    shader.use();
+    for (auto &modelFile : models) {
+        Model &model = *modelFile.first;
+        // warm up, also fills the per-mesh sampler binding cache
+        for (unsigned int i = 0; i < 10; i++)
+            model.Draw(shader);
+        glFinish();
+
+        auto start = std::chrono::steady_clock::now();
+        for (unsigned int i = 0; i < iterations; i++)
+            model.Draw(shader);
+        std::chrono::duration<double, std::micro> elapsed = std::chrono::steady_clock::now() - start;
+        glFinish();
+
+        std::cout << "Model::Draw " << modelFile.second << ": " << model.meshes.size() << " meshes, "
+                  << elapsed.count() / iterations << " us per Draw" << std::endl;
+    }
+}
+
+// time of a swarm step from 1K to 1M agents, on one thread and on a pool of all of them. the box grows with the
+// count so agents keep the same number of neighbors
+void benchmarkSwarm() {
+    ThreadPool pool;
+    const unsigned int steps = 20;
+    std::vector<glm::vec3> lamps = {glm::vec3(0.0f, 2.0f, 0.0f)};
+    for (unsigned int count : {1000u, 10000u, 100000u, 1000000u}) {
+        glm::vec3 extent = glm::vec3(5.0f, 2.0f, 5.0f) * std::cbrt(count / 1000.0f);
+        double milliseconds[2] = {0.0, 0.0};
+        for (unsigned int threaded = 0; threaded < 2; threaded++) {
+            FireflySwarm swarm;
+            swarm.init(count, glm::vec3(0.0f), extent);
+            // first step allocates the grid
+            swarm.update(BENCHMARK_DELTA_TIME, glm::vec3(0.0f, 0.0f, extent.z), lamps, threaded ? &pool : nullptr);
+            auto start = std::chrono::steady_clock::now();
+            for (unsigned int i = 0; i < steps; i++)
+                swarm.update(BENCHMARK_DELTA_TIME, glm::vec3(0.0f, 0.0f, extent.z), lamps, threaded ? &pool : nullptr);
+            milliseconds[threaded] = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / steps;
+        }
+        std::cout << "Swarm " << count << " agents: " << milliseconds[0] << " ms per step on 1 thread, "
+                  << milliseconds[1] << " ms on " << pool.size() << " (" << milliseconds[0] / milliseconds[1] << "x), "
+                  << milliseconds[1] * 1e6 / count << " ns per agent" << std::endl;
+    }
+}
+
+// GPU time of the two bloom paths at 1080p and 4K, on a bright buffer of that size
+void benchmarkBloom(Shader &blurShader, Shader &downsampleShader, Shader &upsampleShader) {
+    const unsigned int iterations = 50;
+    GLuint query;
+    glGenQueries(1, &query);
+    const unsigned int sizes[2][2] = {{1920, 1080}, {3840, 2160}};
+    for (const unsigned int *size : sizes) {
+        GLuint fbo, bright;
+        glGenFramebuffers(1, &fbo);
+        glGenTextures(1, &bright);
+        glBindTexture(GL_TEXTURE_2D, bright);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, size[0], size[1], 0, GL_RGBA, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, bright, 0);
+        glClearColor(2.0f, 1.0f, 0.5f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+
+        BloomRenderer bloom;
+        bloom.init(size[0], size[1], blurShader, downsampleShader, upsampleShader);
+        double milliseconds[2];
+        for (BloomMode mode : {BLOOM_PINGPONG, BLOOM_MIP_CHAIN}) {
+            bloom.mode = mode;
+            // warm up
+            for (unsigned int i = 0; i < 5; i++)
+                bloom.render(bright, blurShader, downsampleShader, upsampleShader);
+            glFinish();
+            glBeginQuery(GL_TIME_ELAPSED, query);
+            for (unsigned int i = 0; i < iterations; i++)
+                bloom.render(bright, blurShader, downsampleShader, upsampleShader);
+            glEndQuery(GL_TIME_ELAPSED);
+            GLuint64 nanoseconds = 0;
+            glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+            milliseconds[mode] = nanoseconds / 1e6 / iterations;
+        }
+        std::cout << "Bloom " << size[0] << "x" << size[1] << ": ping-pong " << milliseconds[BLOOM_PINGPONG]
+                  << " ms, mip chain " << milliseconds[BLOOM_MIP_CHAIN] << " ms ("
+                  << milliseconds[BLOOM_PINGPONG] / milliseconds[BLOOM_MIP_CHAIN] << "x faster)" << std::endl;
+
+        bloom.destroy();
+        glDeleteFramebuffers(1, &fbo);
+        glDeleteTextures(1, &bright);
+    }
+    glDeleteQueries(1, &query);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
+}
+
+// reads the count of a command line option, printing an error when text isn't a whole non-negative number
+bool parseCount(const char *option, const std::string &text, unsigned int &count) {
+    size_t end = 0;
+    unsigned long value = 0;
+    try {
+        if (!text.empty() && text[0] != '-')
+            value = std::stoul(text, &end);
+    } catch (const std::logic_error &) {
+        end = 0;
+    }
+    if (end == 0 || end != text.size() || value > UINT_MAX) {
+        std::cout << "ERROR::OPTIONS:: " << option << " expects a count, got \"" << text << "\"" << std::endl;
+        return false;
+    }
+    count = value;
+    return true;
+}